@@ -0,0 +1,13 @@
+#ifndef APP_TASKS_H
+#define APP_TASKS_H
+
+// Call at the end of setup(), once every module is initialised: starts the
+// control, sensor, UI and network tasks.
+void setup_tasks();
+
+// Call from loop(). On the ESP32 the tasks run on their own and this retires
+// the Arduino loop task; the native build has no scheduler, so each call runs
+// one pass of every task in priority order instead.
+void loop_tasks();
+
+#endif // APP_TASKS_H
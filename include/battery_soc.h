@@ -0,0 +1,44 @@
+#ifndef BATTERY_SOC_H
+#define BATTERY_SOC_H
+
+#include <Arduino.h>
+
+// --- Battery State of Charge ---
+// Coulomb counting on POWER_BATTERY_CHANNEL, kept honest by two anchors:
+// the open-circuit voltage curve of BATTERY_CHEMISTRY once the battery has
+// rested, and a snap to 100% when a charge ends on the tail current. All of
+// it is integer maths on the sensor task, one step per power sample.
+
+static const uint32_t BATTERY_TIME_UNKNOWN = UINT32_MAX;
+
+struct BatteryState {
+  bool valid;                     // False until the battery channel has been sampled
+  bool synced;                    // Anchored by a rest reading or a full charge, not just a first guess
+  uint16_t socPermille;           // 0 to 1000
+  uint32_t remainingMah;
+  int32_t averageCurrentMa;       // Smoothed; positive while charging
+  uint32_t minutesToEmpty;        // BATTERY_TIME_UNKNOWN unless discharging
+  uint32_t minutesToFull;         // BATTERY_TIME_UNKNOWN unless charging
+  int16_t lastFullDriftPermille;  // Counted minus true SoC at the last full charge
+};
+
+// Call in setup(): restores the last saved charge from NVS.
+void setup_battery_soc();
+
+/**
+ * @brief Steps the estimator by one battery sample. Sensor task only.
+ * @param busVoltage Battery terminal voltage in V.
+ * @param current Battery current in mA, positive into the battery.
+ */
+void battery_record_sample(float busVoltage, float current);
+
+// Sensor task: saves the charge every BATTERY_SAVE_INTERVAL.
+void loop_battery_soc();
+
+// Network task: publishes the state every BATTERY_PUBLISH_INTERVAL.
+void loop_battery_publisher();
+
+// Latest estimate, published atomically by the sensor task; safe from any task.
+BatteryState get_battery_state();
+
+#endif // BATTERY_SOC_H
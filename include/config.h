@@ -16,6 +16,9 @@ extern const int SCREEN_WIDTH;
 extern const int SCREEN_HEIGHT;
 extern const int OLED_RESET;
 extern const int OLED_I2C_ADDRESS;
+extern const int OLED_COLUMN_OFFSET;
+extern const uint8_t OLED_CONTRAST;
+extern const uint8_t OLED_DIM_CONTRAST;
 
 // --- Wi-Fi Credentials ---
 extern const char* WIFI_SSID;
@@ -26,6 +29,9 @@ extern const char* MQTT_SERVER;
 extern const char* MQTT_USER;
 extern const char* MQTT_PASSWORD;
 extern const char* DEVICE_ID;
+extern const char* MQTT_CLIENT_ID;
+extern const uint16_t MQTT_PORT;
+extern const uint16_t MQTT_BUFFER_SIZE;
 
 // --- MQTT Topics ---
 extern const char* MQTT_BASE_TOPIC;
@@ -42,12 +48,22 @@ extern const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_BASE;  // shed/monitor/light/ma
 extern const char* MQTT_TOPIC_POWER_CH1_STATE;     // shed/monitor/power/ch1
 extern const char* MQTT_TOPIC_POWER_CH2_STATE;     // shed/monitor/power/ch2
 extern const char* MQTT_TOPIC_POWER_CH3_STATE;     // shed/monitor/power/ch3
+extern const char* MQTT_TOPIC_POWER_STATE;         // shed/monitor/power (batched telemetry)
+extern const char* MQTT_TOPIC_ENERGY_CH1_STATE;    // shed/monitor/energy/ch1
+extern const char* MQTT_TOPIC_ENERGY_CH2_STATE;    // shed/monitor/energy/ch2
+extern const char* MQTT_TOPIC_ENERGY_CH3_STATE;    // shed/monitor/energy/ch3
 
 // --- Topics for functions to address
 extern const char* MQTT_TOPIC_LIGHT_MOTION_TIMER_STATE; // shed/monitor/light/motion_timer/state"
 extern const char* MQTT_TOPIC_LIGHT_MOTION_TIMER_SET;   // shed/monitor/light/motion_timer/set"
 extern const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_STATE; // shed/monitor/light/manual_timer/state"
 extern const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_SET;   // shed/monitor/light/manual_timer/set"
+extern const char* MQTT_TOPIC_DIAGNOSTICS_LOOP;         // shed/monitor/diagnostics/loop
+extern const char* MQTT_TOPIC_HISTORY_GET;              // shed/monitor/history/get
+extern const char* MQTT_TOPIC_HISTORY_STATE;            // shed/monitor/history
+extern const char* MQTT_TOPIC_LIGHT_STATS_STATE;        // shed/monitor/light/stats
+extern const char* MQTT_TOPIC_DIAGNOSTICS_POWER;        // shed/monitor/diagnostics/power
+extern const char* MQTT_TOPIC_BATTERY_STATE;            // shed/monitor/battery
 
 // --- MQTT Payloads ---
 extern const char* MQTT_PAYLOAD_ONLINE;
@@ -61,13 +77,95 @@ extern const float INA226_CH1_SHUNT;
 extern const float INA226_CH2_SHUNT;
 extern const float INA226_CH3_SHUNT;
 
+// When enabled, every INA226 raises its open-drain ALERT line on conversion
+// ready and samples are taken as they complete instead of on a 250 ms poll.
+// Each conversion then averages ~563 ms, so there are no gaps between readings.
+// The ALERT lines are wire-ORed onto INA226_ALERT_PIN.
+extern const bool INA226_USE_ALERT_PIN;
+extern const int INA226_ALERT_PIN;
+
+// Report-by-exception: a channel is republished only when a reading moves by
+// more than max(absolute, percent of last published value), or when the
+// heartbeat interval runs out.
+struct PowerDeadband {
+  float voltageAbs;  // V
+  float voltagePct;
+  float currentAbs;  // mA
+  float currentPct;
+  float powerAbs;    // mW
+  float powerPct;
+};
+extern const PowerDeadband POWER_DEADBANDS[3];
+extern const unsigned long POWER_PUBLISH_HEARTBEAT;
+
+// How power readings go out. The batched modes send every fitted channel in
+// one retained message on MQTT_TOPIC_POWER_STATE, with a sequence number and
+// uptime, whenever any channel is due; discovery follows the mode.
+enum PowerTelemetryMode {
+  POWER_TELEMETRY_PER_CHANNEL,  // One JSON message per channel topic
+  POWER_TELEMETRY_JSON,         // {"seq":..,"uptime_ms":..,"ch1":{...},...}
+  POWER_TELEMETRY_PACKED        // Fixed big-endian binary, see power_monitor.h
+};
+extern const PowerTelemetryMode POWER_TELEMETRY_MODE;
+
+// --- Power Management (see power_manager.h) ---
+extern const int POWER_BATTERY_CHANNEL;
+extern const int SELF_POWER_CHANNEL;
+extern const uint8_t POWER_SAVE_BELOW_PERCENT;
+extern const uint8_t POWER_LOW_BELOW_PERCENT;
+extern const uint8_t POWER_MODE_HYSTERESIS_PERCENT;
+extern const unsigned long POWER_MODE_CHECK_INTERVAL;
+extern const unsigned long POWER_MANAGER_PUBLISH_INTERVAL;
+
+// --- Battery State of Charge (see battery_soc.h) ---
+// Picks the open-circuit voltage curve, full-charge voltage and charge
+// efficiency the estimator uses for POWER_BATTERY_CHANNEL.
+enum BatteryChemistry {
+  BATTERY_LEAD_ACID,  // 12 V flooded or AGM, 6 cells
+  BATTERY_LIFEPO4     // 12.8 V LiFePO4, 4 cells
+};
+extern const BatteryChemistry BATTERY_CHEMISTRY;
+extern const uint32_t BATTERY_CAPACITY_MAH;
+extern const uint32_t BATTERY_REST_CURRENT_MA;
+extern const unsigned long BATTERY_REST_TIME;
+extern const uint32_t BATTERY_FULL_TAIL_CURRENT_MA;
+extern const unsigned long BATTERY_FULL_HOLD_TIME;
+extern const unsigned long BATTERY_PUBLISH_INTERVAL;
+extern const unsigned long BATTERY_SAVE_INTERVAL;
+
 // --- Application Logic Constants ---
-extern unsigned long MOTION_TIMER_DURATION;     // <-- RENAMED & CHANGED
-extern unsigned long MANUAL_TIMER_DURATION;     // <-- ADDED
-extern const int NUM_MODES;
+// The light timers are persistent settings now, see settings.h
 extern const unsigned long INACTIVITY_TIMEOUT;
 extern const int DISPLAY_UPDATE_INTERVAL;
+extern const int DISPLAY_IDLE_UPDATE_INTERVAL;
+extern const unsigned long DISPLAY_DIM_TIMEOUT;
+extern const unsigned long DISPLAY_SLEEP_TIMEOUT;
+extern const unsigned long BUTTON_DEBOUNCE_MS;
+extern const unsigned long BUTTON_DOUBLE_CLICK_MS;
+extern const unsigned long BUTTON_LONG_PRESS_MS;
+extern const unsigned long BUTTON_REPEAT_MS;
 extern const bool PUBLISH_DISCOVERY;
+extern const unsigned long PROFILER_REPORT_INTERVAL;
+
+// --- Energy Counters ---
+extern const unsigned long ENERGY_PUBLISH_INTERVAL;
+extern const unsigned long ENERGY_SAVE_INTERVAL;
+extern const char* NTP_SERVER;
+extern const char* NTP_TIMEZONE;
+
+// --- Settings ---
+extern const unsigned long SETTINGS_WRITE_DELAY;
+
+// --- Light Statistics ---
+extern const unsigned long LIGHT_STATS_PUBLISH_INTERVAL;
+extern const unsigned long LIGHT_STATS_SAVE_INTERVAL;
+
+// --- Connection Manager ---
+extern const unsigned long WIFI_REJOIN_INTERVAL;
+extern const unsigned long RECONNECT_BACKOFF_MIN_MS;
+extern const unsigned long RECONNECT_BACKOFF_MAX_MS;
+extern const uint32_t MQTT_CONNECT_TIMEOUT_MS;
+extern const uint16_t MQTT_SOCKET_TIMEOUT_S;
 
 #endif // CONFIG_H
 
@@ -10,16 +10,34 @@
 // in a different file (in our case, connections.cpp).
 extern PubSubClient client;
 
+// --- Connection Manager States ---
+enum ConnectionState {
+  CONN_WIFI_DOWN,         // Waiting for the access point
+  CONN_WIFI_UP,           // Associated, broker not tried yet
+  CONN_BROKER_CONNECTING, // Next pass attempts client.connect()
+  CONN_ONLINE,            // Connected; client.loop() runs here
+  CONN_BACKOFF            // Waiting out a jittered exponential delay
+};
+
 // This is the public list of functions available from this module.
-void setup_wifi();
-void reconnect();
-void mqtt_discovery();
+void setup_connections(); // Starts Wi-Fi without waiting for it
+void loop_connections();  // Advances the state machine, never blocks for long
+ConnectionState get_connection_state();
 void mqtt_callback(char* topic, byte* payload, unsigned int length);
 
-// New function declarations for handling specific MQTT commands
-void handle_lights_command(String message);
-void handle_motion_timer_command(String message);
-void handle_manual_timer_command(String message);
+/**
+ * @brief Publishes a payload by streaming it straight from render(), so it
+ * never has to fit the client's packet buffer. render() is called twice: once
+ * to measure the payload and once to send it, and must write the same bytes.
+ * @return True if the whole message was handed to the socket.
+ */
+bool publish_streamed(const char* topic, void (*render)(Print& out), bool retained);
+
+// Handlers for the MQTT command topics. The payload is a view into the
+// client's buffer: not NUL-terminated, valid only for the call.
+void handle_lights_command(const char* payload, size_t length);
+void handle_motion_timer_command(const char* payload, size_t length);
+void handle_manual_timer_command(const char* payload, size_t length);
 
 #endif // CONNECTIONS_H
 
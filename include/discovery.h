@@ -0,0 +1,10 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+// Publishes the Home Assistant device-discovery documents: the main one
+// (lights, PIR, timers, per-channel V/I/P, light statistics, battery state of
+// charge) and the energy counters. Both are written straight from constant
+// descriptor tables in discovery.cpp.
+void mqtt_discovery();
+
+#endif // DISCOVERY_H
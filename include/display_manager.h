@@ -2,24 +2,7 @@
 #define DISPLAY_MANAGER_H
 
 #include <Arduino.h>
-
-// --- UI State Enums ---
-// By placing these here, both main.cpp and display_manager.cpp can see them.
-enum DisplayMode {
-  POWER_MODE_ALL,
-  POWER_MODE_CH1,
-  POWER_MODE_CH2,
-  POWER_MODE_CH3,
-  LIGHTS_MODE
-};
-
-enum LightsSubMode { 
-  LIVE_STATUS, 
-  LIGHTS_MENU, 
-  EDIT_MOTION_TIMER, 
-  EDIT_MANUAL_TIMER 
-};
-enum PowerSubMode { LIVE_POWER, POWER_SUBSCREEN };
+#include "battery_soc.h"
 
 // --- Display Data Structure ---
 // This struct packages up all the data the display might need,
@@ -29,9 +12,11 @@ struct DisplayData {
   bool lightManualOverride;
   unsigned long lastMotionTime;
   unsigned long lightOnTime;
+  unsigned long currentTimerDuration;   // Motion or manual timer, whichever is running
   float busVoltage[3];
   float current[3];
   float power[3];
+  BatteryState battery;                  // Shown on the POWER_BATTERY_CHANNEL screen
   int lightsMenuSelection;
   unsigned long tempMotionTimerDuration; // <-- ADDED
   unsigned long tempManualTimerDuration; // <-- ADDED
@@ -43,8 +28,33 @@ struct DisplayData {
 // Call this in setup() to initialize the screen
 void setup_display();
 
-// This is the single, high-level function that main.cpp will call to handle all drawing.
-void update_display(DisplayMode mode, LightsSubMode lightsSub, PowerSubMode powerSub, const DisplayData& data);
+// --- Screen Renderers ---
+// Each draws one complete screen and flushes it to the panel. The screen graph
+// in user_interface.cpp picks which one runs and when.
+void draw_power_all_screen(const DisplayData& data);
+void draw_power_channel_screen(int channel, const DisplayData& data);  // channel 1..3
+void draw_power_trend_screen(int channel, const DisplayData& data);    // channel 1..3
+void draw_lights_live_screen(const DisplayData& data);
+void draw_lights_menu_screen(const DisplayData& data);
+void draw_edit_timer_screen(const DisplayData& data, bool isMotionTimer);
+void draw_diagnostics_screen();
+
+// Call when a different screen is about to be drawn. Screens that keep state in
+// the framebuffer between frames (the trend charts) start over after this.
+void display_screen_changed();
+
+// --- Panel Power ---
+enum DisplayPower {
+  DISPLAY_AWAKE,   // OLED_CONTRAST
+  DISPLAY_DIMMED,  // OLED_DIM_CONTRAST
+  DISPLAY_ASLEEP   // Panel off; its RAM keeps the last frame
+};
+
+// Dims or blanks the panel. Does nothing if it is already at that level.
+void set_display_power(DisplayPower power);
+
+// I2C bytes sent to the OLED during the last full second (dirty regions only).
+unsigned long get_display_bytes_per_second();
 
 
 #endif // DISPLAY_MANAGER_H
@@ -1,12 +1,36 @@
 #ifndef ENCODER_H
 #define ENCODER_H
 
+// --- Button Events ---
+// A click is only reported once the double-click window has passed without
+// a second press, so a double click never also produces a click.
+enum ButtonEventType {
+  BUTTON_CLICK,
+  BUTTON_DOUBLE_CLICK,
+  BUTTON_LONG_PRESS,   // Held for BUTTON_LONG_PRESS_MS
+  BUTTON_HOLD_REPEAT   // Every BUTTON_REPEAT_MS while still held after a long press
+};
+
+struct ButtonEvent {
+  ButtonEventType type;
+  unsigned long time;  // millis() of the press that started it; repeats carry their own
+};
+
 // Public functions available to the rest of the application
 void setup_encoder();
-void loop_encoder(); // This should be called in the main loop()
+void loop_encoder(); // UI task: debounces the button and turns it into events
 
 // Functions to check the encoder's state
 int get_encoder_value(); // This function now returns the persistent counter value
-bool button_was_clicked(); // Returns true on a single click, resets after read
+// Both counters from one read, so a detent between them cannot split a turn.
+// `accelerated` is the same count with each detent of a fast spin worth
+// several; use it for values with a wide range, `value` for menus.
+struct EncoderPosition {
+  int value;
+  int accelerated;
+};
+EncoderPosition get_encoder_position();
+// Takes the oldest pending button event; false if there is none.
+bool get_button_event(ButtonEvent& event);
 
 #endif // ENCODER_H
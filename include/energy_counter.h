@@ -0,0 +1,43 @@
+#ifndef ENERGY_COUNTER_H
+#define ENERGY_COUNTER_H
+
+// --- Accumulation Periods ---
+enum EnergyPeriod {
+  ENERGY_DAY,       // Since local midnight (needs SNTP time, else since boot)
+  ENERGY_WEEK,      // Since Monday 00:00 local time
+  ENERGY_LIFETIME,  // Never resets
+  ENERGY_PERIOD_COUNT
+};
+
+// Call in setup(): restores the counters saved in NVS.
+void setup_energy();
+
+/**
+ * @brief Integrates one sample per channel into every counter (trapezoidal rule).
+ * Sensor task only.
+ * @param power Latest power per channel in mW (magnitude, as the INA226 reports it).
+ * @param current Latest current per channel in mA; its sign picks the direction.
+ */
+void energy_record_sample(const float power[3], const float current[3]);
+
+// Sensor task: handles day/week rollover and periodic saving.
+void loop_energy();
+
+// Network task: publishes the counters once a minute.
+void loop_energy_publisher();
+
+/**
+ * @brief Reads an energy counter.
+ * @param channel Power channel, 1 to 3.
+ * @param discharge False for energy flowing with positive current, true for negative.
+ * @return Energy in Wh.
+ */
+float get_energy_wh(int channel, EnergyPeriod period, bool discharge);
+
+/**
+ * @brief Reads a charge counter, same conventions as get_energy_wh().
+ * @return Charge in Ah.
+ */
+float get_charge_ah(int channel, EnergyPeriod period, bool discharge);
+
+#endif // ENERGY_COUNTER_H
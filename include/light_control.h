@@ -0,0 +1,59 @@
+#ifndef LIGHT_CONTROL_H
+#define LIGHT_CONTROL_H
+
+#include <Arduino.h>
+
+// --- Commands into the control task ---
+enum LightCommandType {
+  LIGHT_CMD_ON,                 // Manual override on
+  LIGHT_CMD_OFF,                // Manual override off, light follows the PIR again
+  LIGHT_CMD_SET_MOTION_TIMER,   // value = duration in ms
+  LIGHT_CMD_SET_MANUAL_TIMER    // value = duration in ms
+};
+
+struct LightCommand {
+  LightCommandType type;
+  unsigned long value;
+};
+
+// --- Published state of the control task ---
+struct LightState {
+  bool lightIsOn;
+  bool lightManualOverride;
+  bool motionDetected;            // Raw PIR level
+  unsigned long lastMotionTime;   // Start of the running timer
+  unsigned long lightOnTime;
+  unsigned long motionTimerDuration;
+  unsigned long manualTimerDuration;
+};
+
+// Call in setup(): drives the relay and LED pins low.
+void setup_light_control();
+
+// Control task: applies queued commands, follows the PIR and drives the relay.
+// Never touches the network or the display.
+void loop_light_control();
+
+/**
+ * @brief Queues a command from the UI task (the only caller allowed).
+ * @return False if the queue is full and the command was dropped.
+ */
+bool send_light_command_from_ui(const LightCommand& command);
+
+/**
+ * @brief Queues a command from the network task (the only caller allowed).
+ * @return False if the queue is full and the command was dropped.
+ */
+bool send_light_command_from_network(const LightCommand& command);
+
+// Latest state published by the control task; safe from any task.
+LightState get_light_state();
+
+// Network task: publishes the motion, occupancy, light and timer changes the
+// control task has queued since the last call.
+void loop_light_publisher();
+
+// Network task: publishes the current timer durations (used on connect).
+void publish_light_timers();
+
+#endif // LIGHT_CONTROL_H
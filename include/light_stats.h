@@ -0,0 +1,49 @@
+#ifndef LIGHT_STATS_H
+#define LIGHT_STATS_H
+
+#include <Arduino.h>
+
+// --- Rolling Windows ---
+enum LightStatsWindow {
+  LIGHT_STATS_24H,
+  LIGHT_STATS_7D,
+  LIGHT_STATS_WINDOW_COUNT
+};
+
+struct LightStatsWindowSummary {
+  uint32_t relayOnSeconds;
+  uint32_t switchCount;    // Relay off -> on transitions
+  float motionPerHour;     // PIR rising edges
+  float occupancyPercent;  // Share of the window the light was on for motion
+};
+
+struct LightStatsSummary {
+  LightStatsWindowSummary windows[LIGHT_STATS_WINDOW_COUNT];
+  uint32_t lifetimeSwitchCount;  // Relay cycles since the counters were created
+  uint32_t lifetimeOnSeconds;
+  uint32_t droppedEvents;        // Edges lost to a full queue since boot
+};
+
+// Call in setup(): restores the counters saved in NVS.
+void setup_light_stats();
+
+/**
+ * @brief Records a relay edge. Control task only; never blocks.
+ * @param manual True if the relay came on for a manual override rather than motion.
+ */
+void light_stats_relay_changed(bool on, bool manual);
+
+// Records a PIR rising edge. Control task only; never blocks.
+void light_stats_motion();
+
+// Sensor task: folds in the recorded edges, rolls the hourly buckets and
+// saves the counters every LIGHT_STATS_SAVE_INTERVAL.
+void loop_light_stats();
+
+// Network task: publishes the summary every LIGHT_STATS_PUBLISH_INTERVAL.
+void loop_light_stats_publisher();
+
+// Latest summary, published atomically by the sensor task; safe from any task.
+LightStatsSummary get_light_stats();
+
+#endif // LIGHT_STATS_H
@@ -0,0 +1,59 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <stdint.h>
+
+// --- Profiled Stages ---
+// Each stage must only be timed from one task (see app_tasks.cpp).
+enum ProfileStage {
+  PROFILE_MQTT,     // Network task pass: connection, publishing, MQTT callbacks
+  PROFILE_ENCODER,  // loop_encoder()
+  PROFILE_INPUT,    // UI input handling
+  PROFILE_LIGHTS,   // Control task pass: PIR and relay
+  PROFILE_POWER,    // Sensor task pass: loop_power_monitor() and loop_energy()
+  PROFILE_DISPLAY,  // Screen render and flush
+  PROFILE_LOOP,     // Control task period, start to start; shows anything delaying the relay
+  PROFILE_MOTION,   // PIR edge (interrupt) to relay on, when the edge switched the light
+  PROFILE_STAGE_COUNT
+};
+
+// --- Summary of one reporting window, all times in microseconds ---
+struct ProfileStats {
+  uint32_t epoch;   // Window the stats cover
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t avgUs;
+  uint32_t maxUs;
+  uint32_t p99Us;   // Upper edge of the histogram bucket holding the 99th percentile
+};
+
+void setup_profiler();
+
+/**
+ * @brief Marks the start of a timed section. Safe from an ISR.
+ * @return The current time in microseconds, to be passed to profile_end().
+ */
+uint32_t profile_start();
+
+/**
+ * @brief Records the time elapsed since profile_start() against a stage.
+ * @param stage The stage being timed.
+ * @param startUs The value returned by the matching profile_start().
+ */
+void profile_end(ProfileStage stage, uint32_t startUs);
+
+// Network task: starts a new window and publishes the summary when due.
+void loop_profiler();
+
+/**
+ * @brief Stats of the last reported window (what the diagnostics screen shows).
+ * PROFILE_MQTT is written by the network task, the lowest priority of all, so
+ * this never waits for a writer that may be preempted mid-update.
+ * @param stats Receives the stats, zeroed if the stage had no samples in that
+ * window; left untouched if they were being updated.
+ * @return False if the caller should keep showing its previous copy.
+ */
+bool get_profile_stats(ProfileStage stage, ProfileStats& stats);
+const char* get_profile_stage_name(ProfileStage stage);
+
+#endif // LOOP_PROFILER_H
@@ -0,0 +1,63 @@
+#ifndef POWER_HISTORY_H
+#define POWER_HISTORY_H
+
+#include <Arduino.h>
+
+// --- History Tiers ---
+// Each tier is a fixed ring of min/mean/max slots for every channel, fed by
+// the tier below it. Sizes are compile-time so the whole store is static.
+enum HistoryTier {
+  HISTORY_1S,     // 1 second slots
+  HISTORY_1MIN,   // 1 minute slots
+  HISTORY_15MIN,  // 15 minute slots
+  HISTORY_TIER_COUNT
+};
+
+enum HistoryQuantity {
+  HISTORY_VOLTAGE,  // V
+  HISTORY_CURRENT,  // mA
+  HISTORY_POWER,    // mW
+  HISTORY_QUANTITY_COUNT
+};
+
+static const int HISTORY_1S_SLOTS = 96;     // ~1.5 minutes
+static const int HISTORY_1MIN_SLOTS = 60;   // 1 hour
+static const int HISTORY_15MIN_SLOTS = 48;  // 12 hours
+
+// A decoded slot, in the same units as the power monitor getters.
+struct HistoryPoint {
+  float min;
+  float mean;
+  float max;
+};
+
+/**
+ * @brief Feeds one sensor reading for all three channels into the 1 s tier.
+ * Called by the power monitor at its sample rate; closes slots as time passes.
+ */
+void history_record_sample(const float busVoltage[3], const float current[3], const float power[3]);
+
+/**
+ * @brief Number of filled slots in a tier (grows until the ring is full).
+ */
+int history_count(HistoryTier tier);
+
+/**
+ * @brief Reads one slot from a tier.
+ * @param channel Power channel, 1 to 3.
+ * @param age 0 for the newest completed slot, up to history_count() - 1.
+ * @return False if the channel or age is out of range.
+ */
+bool history_get(HistoryTier tier, int channel, HistoryQuantity quantity, int age, HistoryPoint& out);
+
+/**
+ * @brief Increments every time a slot is closed in the tier, so readers can
+ * tell whether anything new arrived since they last looked.
+ */
+uint32_t history_sequence(HistoryTier tier);
+
+// MQTT query: payload "<channel> <tier>", e.g. "2 1m". Tier is 1s, 1m or 15m.
+// The payload is a view into the client's buffer and is not NUL-terminated.
+void handle_history_command(const char* payload, size_t length);
+
+#endif // POWER_HISTORY_H
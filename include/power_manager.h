@@ -0,0 +1,47 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+
+// --- Power Modes ---
+// Picked from the battery's state of charge (see battery_soc.h): the flatter
+// the battery, the deeper the controller sleeps.
+enum PowerMode {
+  POWER_MODE_FULL,  // CPU at full clock, no light sleep
+  POWER_MODE_SAVE,  // Automatic light sleep between task passes
+  POWER_MODE_LOW,   // Light sleep, slower task cadence, Wi-Fi skips DTIM beacons
+  POWER_MODE_COUNT
+};
+
+// Call in setup(), after setup_connections(): arms the GPIO wake sources.
+void setup_power_manager();
+
+// Sensor task: follows the state of charge and switches modes. The GPIO wake
+// levels are re-armed by the pins' own ISRs, see rearm_wake_interrupt().
+void loop_power_manager();
+
+// Network task: publishes the mode and the controller's own draw to
+// MQTT_TOPIC_DIAGNOSTICS_POWER every POWER_MANAGER_PUBLISH_INTERVAL.
+void loop_power_manager_publisher();
+
+PowerMode get_power_mode();
+
+// --- Wake-Capable Pin Interrupts ---
+// Light sleep stops the GPIO edge detector, so CHANGE interrupts would miss
+// edges and could not wake the chip. These pins use level interrupts that are
+// also wake sources instead: the ISR re-arms its pin for the opposite level,
+// which behaves like CHANGE. The native build simply uses CHANGE.
+
+// Call from a module's setup in place of attachInterrupt(..., CHANGE).
+void attach_wake_interrupt(int pin, void (*isr)());
+
+// Call from that ISR with the level it just read from the pin.
+void rearm_wake_interrupt(int pin, int level);
+
+/**
+ * @brief How much the current mode stretches the task periods.
+ * @return 1 in POWER_MODE_FULL, larger in the saving modes. Safe from any task.
+ */
+uint32_t get_task_period_scale();
+
+#endif // POWER_MANAGER_H
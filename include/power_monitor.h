@@ -1,8 +1,39 @@
 #ifndef POWER_MONITOR_H
 #define POWER_MONITOR_H
 
+#include <Arduino.h>
+
+// --- Latest Reading of All Channels ---
+struct PowerReadings {
+  float busVoltage[3];  // V
+  float current[3];     // mA
+  float power[3];       // mW
+};
+
+// --- Packed Telemetry Layout ---
+// POWER_TELEMETRY_PACKED payload, all fields big-endian:
+//   0  uint8   format version (POWER_PACKED_VERSION)
+//   1  uint8   fitted channels, bit n = channel n + 1
+//   2  uint32  sequence number
+//   6  uint32  uptime in ms
+//   10 + 12 * (channel - 1): float32 bus voltage (V), current (mA), power (mW)
+// Every channel keeps its slot, so offsets are fixed; unfitted slots are 0.
+static const uint8_t POWER_PACKED_VERSION = 1;
+static const int POWER_PACKED_HEADER_BYTES = 10;
+static const int POWER_PACKED_CHANNEL_BYTES = 12;
+static const int POWER_PACKED_BYTES = POWER_PACKED_HEADER_BYTES + 3 * POWER_PACKED_CHANNEL_BYTES;
+
 void setup_power_monitor();
+// Sensor task: samples the INA226s and feeds the history and energy counters.
 void loop_power_monitor();
+// Network task: publishes channels whose reading left its deadband.
+void loop_power_publisher();
+
+// Latest readings, published atomically by the sensor task; safe from any task.
+PowerReadings get_power_readings();
+
+// False for channels with no sensor fitted (1 to 3).
+bool power_channel_fitted(int channel);
 
 // --- Data Getter Functions ---
 float get_bus_voltage(int channel);
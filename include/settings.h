@@ -0,0 +1,37 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+
+// --- Persistent Settings ---
+// Values that survive a reboot. They live in a RAM cache that is loaded from
+// NVS once at boot; changes are written back in the background.
+enum SettingId {
+  SETTING_MOTION_TIMER,  // ms the light stays on after motion
+  SETTING_MANUAL_TIMER,  // ms a manual ON lasts
+  SETTING_COUNT
+};
+
+// Call in setup() before anything reads a setting or connects to the broker,
+// so retained /set messages are applied on top of the stored values.
+void setup_settings();
+
+/**
+ * @brief Reads a setting from the RAM cache. Safe from any task.
+ */
+uint32_t get_setting(SettingId id);
+
+/**
+ * @brief Changes a setting in RAM and marks it dirty; nothing is written yet.
+ * @return False (and no change) if the value is outside the setting's range.
+ */
+bool set_setting(SettingId id, uint32_t value);
+
+/**
+ * @brief Writes dirty settings to NVS once no change has been made for
+ * SETTINGS_WRITE_DELAY, so a burst of edits costs a single flash write.
+ * Sensor task only.
+ */
+void loop_settings();
+
+#endif // SETTINGS_H
@@ -0,0 +1,74 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @brief A value published by one writer task and read by any number of
+ * reader tasks without locks (a sequence lock).
+ *
+ * The writer bumps the sequence to an odd number, copies the value in and
+ * bumps it to even again; a reader retries if the sequence was odd or moved
+ * while it copied. T must be trivially copyable.
+ *
+ * On the single-core ESP32-C6 a reader spins for as long as the writer is
+ * preempted mid-copy, so read() needs the writer to run at a higher priority
+ * than the reader (see app_tasks.cpp). A lower-priority writer can only be
+ * read with try_read().
+ */
+template <typename T>
+class Snapshot {
+public:
+  // Writer side only.
+  void publish(const T& value) {
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    value_ = value;
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T read() const {
+    T copy;
+    uint32_t before, after;
+    do {
+      before = sequence_.load(std::memory_order_acquire);
+      copy = value_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return copy;
+  }
+
+  /**
+   * @brief Reads without spinning on a writer that may be preempted mid-copy.
+   * @param value Receives the value; left untouched on failure.
+   * @param attempts Copies to try before giving up.
+   * @return False if no consistent copy was seen; keep the last good value.
+   */
+  bool try_read(T& value, int attempts = 3) const {
+    for (int i = 0; i < attempts; i++) {
+      uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) continue;
+      T copy = value_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) {
+        value = copy;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Number of publishes so far; lets a reader skip values it has already seen.
+  uint32_t version() const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  T value_{};
+  std::atomic<uint32_t> sequence_{0};
+};
+
+#endif // SNAPSHOT_H
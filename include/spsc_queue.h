@@ -0,0 +1,44 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+/**
+ * @brief Bounded lock-free queue between exactly one producer task and
+ * exactly one consumer task. Neither side ever blocks: push() fails when the
+ * queue is full and pop() fails when it is empty.
+ *
+ * The indices run freely and are masked on access, so Capacity must be a
+ * power of two and every slot is usable.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  // Producer side only.
+  bool push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Capacity) return false;
+    items_[head & (Capacity - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side only.
+  bool pop(T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    item = items_[tail & (Capacity - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items_[Capacity];
+  std::atomic<size_t> head_{0};  // Written by the producer
+  std::atomic<size_t> tail_{0};  // Written by the consumer
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,63 @@
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Allocation-Free Text Formatting ---
+// Everything here writes into caller-provided char arrays: no String, no
+// JsonDocument, no printf. The UI and the MQTT publishers format every frame
+// and every sample, and on a long-running device each of those heap round
+// trips fragments the heap a little more.
+
+// "HH:MM:SS", with room for any hour count an unsigned long can hold
+static const size_t DURATION_TEXT_SIZE = 20;
+
+/**
+ * @brief Appends formatted text to a fixed char array.
+ *
+ * The text is always null-terminated. Anything that does not fit is dropped
+ * and overflowed() reports it, so callers can size buffers generously and
+ * check once at the end.
+ */
+class TextBuffer {
+public:
+  TextBuffer(char* buffer, size_t size);
+
+  TextBuffer& append(const char* text);
+  TextBuffer& append(char c);
+  TextBuffer& append_unsigned(uint32_t value);
+  TextBuffer& append_signed(int32_t value);
+
+  /**
+   * @brief Appends a value rounded to a fixed number of decimals.
+   * @param value The value; NaN and infinities are written as "null", so a
+   * JSON payload stays valid.
+   * @param decimals Digits after the point, 0..6.
+   */
+  TextBuffer& append_fixed(float value, uint8_t decimals);
+
+  /**
+   * @brief Appends a duration as HH:MM:SS.
+   * @param milliseconds The duration to format.
+   */
+  TextBuffer& append_duration(unsigned long milliseconds);
+
+  const char* c_str() const { return buffer; }
+  size_t length() const { return used; }
+  bool overflowed() const { return truncated; }
+
+private:
+  char* buffer;
+  size_t size;
+  size_t used;
+  bool truncated;
+};
+
+// --- Single-Field Shortcuts ---
+// Each writes one value into `text` and returns its length.
+size_t format_unsigned(char* text, size_t size, uint32_t value);
+size_t format_fixed(char* text, size_t size, float value, uint8_t decimals);
+size_t format_duration(char (&text)[DURATION_TEXT_SIZE], unsigned long milliseconds);
+
+#endif // TEXT_FORMAT_H
@@ -0,0 +1,12 @@
+#ifndef USER_INTERFACE_H
+#define USER_INTERFACE_H
+
+// Call in setup() after setup_display() and setup_encoder().
+void setup_user_interface();
+
+// UI task: reads the encoder, routes input, and redraws the display from the
+// published light and power snapshots. Light changes go to the control task
+// as commands; nothing here publishes to MQTT.
+void loop_user_interface();
+
+#endif // USER_INTERFACE_H
@@ -5,13 +5,6 @@
 
 // --- Public Function Declarations ---
 
-/**
- * @brief Formats a duration in milliseconds into a HH:MM:SS string.
- * @param milliseconds The duration to format.
- * @return A String object with the formatted time.
- */
-String formatDuration(unsigned long milliseconds);
-
 /**
  * @brief Determines the correct light timer duration based on the override state.
  * @param isManualOverride True if the light was turned on by HA, false otherwise.
@@ -19,4 +12,28 @@ String formatDuration(unsigned long milliseconds);
  */
 unsigned long get_current_timer_duration(bool isManualOverride);
 
+// --- Payload Parsing ---
+// MQTT payloads are not NUL-terminated; these never read past `length`.
+
+/**
+ * @brief Hashes a topic with 32-bit FNV-1a, for the MQTT command router.
+ * @param data The topic characters.
+ * @param length Number of characters to hash.
+ */
+uint32_t hash_topic(const char* data, size_t length);
+
+/**
+ * @brief Compares a payload with a C string, exactly.
+ * @return True if the payload is the same text.
+ */
+bool payload_equals(const char* payload, size_t length, const char* text);
+
+/**
+ * @brief Parses a non-negative decimal number such as "300" or "300.0".
+ * Surrounding spaces are ignored and a fractional part is truncated.
+ * @param value Receives the number on success.
+ * @return False if the payload is empty, has stray characters or overflows.
+ */
+bool parse_unsigned(const char* payload, size_t length, unsigned long& value);
+
 #endif // UTILS_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+// Host-side stand-in for the Adafruit GFX library (native env only).
+// Primitives are rasterised through drawPixel() so the framebuffer still changes
+// between frames; text output is not rendered and only advances the cursor.
+
+#ifndef NATIVE_HAL_ADAFRUIT_GFX_H
+#define NATIVE_HAL_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h) {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+  void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color);
+  void fillScreen(uint16_t color) { fillRect(0, 0, WIDTH, HEIGHT, color); }
+  void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color);
+  void drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color, uint16_t bg);
+
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  void setTextSize(uint8_t s) { textsize = s ? s : 1; }
+  void setTextColor(uint16_t c) { textcolor = c; }
+  void setTextColor(uint16_t c, uint16_t bg) { textcolor = c; (void)bg; }
+  void setTextWrap(bool w) { (void)w; }
+  void getTextBounds(const char* string, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+  void getTextBounds(const String& str, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  int16_t width() const { return WIDTH; }
+  int16_t height() const { return HEIGHT; }
+
+protected:
+  const int16_t WIDTH;
+  const int16_t HEIGHT;
+  int16_t cursor_x = 0;
+  int16_t cursor_y = 0;
+  uint8_t textsize = 1;
+  uint16_t textcolor = 1;
+};
+
+class GFXcanvas1 : public Adafruit_GFX {
+public:
+  GFXcanvas1(uint16_t w, uint16_t h);
+  ~GFXcanvas1();
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  uint8_t* getBuffer() const { return buffer; }
+
+private:
+  uint8_t* buffer;
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_GFX_H
@@ -0,0 +1,37 @@
+// Host-side stand-in for the Adafruit SH110X library (native env only).
+// Keeps a real page-ordered framebuffer so the flush path in display_manager
+// runs unchanged; nothing is sent anywhere on display().
+
+#ifndef NATIVE_HAL_ADAFRUIT_SH110X_H
+#define NATIVE_HAL_ADAFRUIT_SH110X_H
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SH110X_BLACK 0
+#define SH110X_WHITE 1
+#define SH110X_INVERSE 2
+
+#define SH110X_DISPLAYOFF 0xAE
+#define SH110X_DISPLAYON 0xAF
+#define SH110X_SETCONTRAST 0x81
+
+class Adafruit_SH1107 : public Adafruit_GFX {
+public:
+  Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire* twi = &Wire, int8_t rst_pin = -1,
+                  uint32_t preclk = 400000, uint32_t postclk = 100000);
+  ~Adafruit_SH1107();
+
+  bool begin(uint8_t addr = 0x3C, bool reset = true);
+  void display();
+  void clearDisplay();
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  uint8_t* getBuffer() { return buffer; }
+  void setContrast(uint8_t contrast) { (void)contrast; }
+  void oled_command(uint8_t c) { (void)c; }
+
+private:
+  uint8_t* buffer = nullptr;
+};
+
+#endif // NATIVE_HAL_ADAFRUIT_SH110X_H
@@ -0,0 +1,180 @@
+// Host-side stand-in for the Arduino core, used only by the `native` env.
+// It provides just enough of the API for the firmware in src/ to compile and
+// run on Linux: a fake clock, fake GPIO pins with interrupts, a silent Serial
+// and a std::string backed String. The simulation controls live in hal_fake.h.
+
+#ifndef NATIVE_HAL_ARDUINO_H
+#define NATIVE_HAL_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define LED_BUILTIN 15
+
+#define IRAM_ATTR
+#define F(string_literal) (string_literal)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::min;
+using std::max;
+
+// --- Time ---
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// --- CPU ---
+// The cycle counter follows the host's monotonic clock scaled to the CPU
+// frequency, so the loop profiler measures real host execution time.
+uint32_t getCpuFrequencyMhz();
+
+// The heap getters report a fixed, unfragmented heap; the host allocator has
+// nothing in common with the ESP32's.
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+// --- Time of Day ---
+// SNTP is not simulated; time() returns the host's wall clock unless a test
+// sets one with fake_clock_set_epoch() (hal_fake.h).
+void configTzTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+// --- GPIO ---
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void noInterrupts();
+void interrupts();
+
+// --- Math helpers ---
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// --- String ---
+class String {
+public:
+  String() {}
+  String(const char* cstr) : s_(cstr ? cstr : "") {}
+  String(const std::string& str) : s_(str) {}
+  String(char c) : s_(1, c) {}
+  String(int value, unsigned char base = 10) : s_(format_integer(value, base)) {}
+  String(unsigned int value, unsigned char base = 10) : s_(format_integer(value, base)) {}
+  String(long value, unsigned char base = 10) : s_(format_integer(value, base)) {}
+  String(unsigned long value, unsigned char base = 10) : s_(format_integer(value, base)) {}
+  String(float value, unsigned int decimals = 2) : s_(format_float(value, decimals)) {}
+  String(double value, unsigned int decimals = 2) : s_(format_float(value, decimals)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.length(); }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+  bool concat(const String& other) { s_ += other.s_; return true; }
+  bool concat(const char* cstr) { if (cstr) s_ += cstr; return true; }
+  bool reserve(unsigned int size) { s_.reserve(size); return true; }
+  int indexOf(char c, unsigned int fromIndex = 0) const {
+    std::string::size_type pos = s_.find(c, fromIndex);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  String substring(unsigned int beginIndex) const { return beginIndex < s_.length() ? String(s_.substr(beginIndex)) : String(); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const {
+    if (beginIndex >= s_.length() || endIndex <= beginIndex) return String();
+    return String(s_.substr(beginIndex, endIndex - beginIndex));
+  }
+
+  String& operator+=(const String& other) { s_ += other.s_; return *this; }
+  String& operator+=(const char* cstr) { if (cstr) s_ += cstr; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(const String& lhs, const String& rhs) { return String(lhs.s_ + rhs.s_); }
+  friend String operator+(const String& lhs, const char* rhs) { return String(lhs.s_ + (rhs ? rhs : "")); }
+  friend String operator+(const char* lhs, const String& rhs) { return String((lhs ? lhs : "") + rhs.s_); }
+
+  bool operator==(const String& other) const { return s_ == other.s_; }
+  bool operator==(const char* cstr) const { return cstr && s_ == cstr; }
+  bool operator!=(const String& other) const { return s_ != other.s_; }
+  bool operator!=(const char* cstr) const { return !(*this == cstr); }
+  char operator[](unsigned int index) const { return index < s_.length() ? s_[index] : 0; }
+
+private:
+  static std::string format_integer(long long value, unsigned char base);
+  static std::string format_float(double value, unsigned int decimals);
+  std::string s_;
+};
+
+// --- Print / Serial ---
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets_{a, b, c, d} {}
+  String toString() const;
+private:
+  uint8_t octets_[4];
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& str) { return write(str.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = 10) { return print(String((long)value, base)); }
+  size_t print(unsigned int value, int base = 10) { return print(String((unsigned long)value, base)); }
+  size_t print(long value, int base = 10) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = 10) { return print(String(value, base)); }
+  size_t print(double value, int digits = 2) { return print(String(value, digits)); }
+  size_t print(const IPAddress& address) { return print(address.toString()); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// --- Application entry points (defined in src/main.cpp) ---
+void setup();
+void loop();
+
+#endif // NATIVE_HAL_ARDUINO_H
@@ -0,0 +1,14 @@
+// Host-side stand-in for the Arduino Client interface (native env only).
+
+#ifndef NATIVE_HAL_CLIENT_H
+#define NATIVE_HAL_CLIENT_H
+
+#include <Arduino.h>
+
+class Client : public Print {
+public:
+  size_t write(uint8_t c) override { (void)c; return 1; }
+  using Print::write;
+};
+
+#endif // NATIVE_HAL_CLIENT_H
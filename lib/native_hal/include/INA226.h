@@ -0,0 +1,75 @@
+// Host-side stand-in for the jarzebski INA226 library (native env only).
+// Readings come from a per-address table set with fake_ina226_set().
+
+#ifndef NATIVE_HAL_INA226_H
+#define NATIVE_HAL_INA226_H
+
+#include <Arduino.h>
+
+typedef enum {
+  INA226_AVERAGES_1 = 0b000,
+  INA226_AVERAGES_4 = 0b001,
+  INA226_AVERAGES_16 = 0b010,
+  INA226_AVERAGES_64 = 0b011,
+  INA226_AVERAGES_128 = 0b100,
+  INA226_AVERAGES_256 = 0b101,
+  INA226_AVERAGES_512 = 0b110,
+  INA226_AVERAGES_1024 = 0b111
+} ina226_averages_t;
+
+typedef enum {
+  INA226_BUS_CONV_TIME_140US = 0b000,
+  INA226_BUS_CONV_TIME_204US = 0b001,
+  INA226_BUS_CONV_TIME_332US = 0b010,
+  INA226_BUS_CONV_TIME_588US = 0b011,
+  INA226_BUS_CONV_TIME_1100US = 0b100,
+  INA226_BUS_CONV_TIME_2116US = 0b101,
+  INA226_BUS_CONV_TIME_4156US = 0b110,
+  INA226_BUS_CONV_TIME_8244US = 0b111
+} ina226_busConvTime_t;
+
+typedef enum {
+  INA226_SHUNT_CONV_TIME_140US = 0b000,
+  INA226_SHUNT_CONV_TIME_204US = 0b001,
+  INA226_SHUNT_CONV_TIME_332US = 0b010,
+  INA226_SHUNT_CONV_TIME_588US = 0b011,
+  INA226_SHUNT_CONV_TIME_1100US = 0b100,
+  INA226_SHUNT_CONV_TIME_2116US = 0b101,
+  INA226_SHUNT_CONV_TIME_4156US = 0b110,
+  INA226_SHUNT_CONV_TIME_8244US = 0b111
+} ina226_shuntConvTime_t;
+
+typedef enum {
+  INA226_MODE_POWER_DOWN = 0b000,
+  INA226_MODE_SHUNT_TRIG = 0b001,
+  INA226_MODE_BUS_TRIG = 0b010,
+  INA226_MODE_SHUNT_BUS_TRIG = 0b011,
+  INA226_MODE_ADC_OFF = 0b100,
+  INA226_MODE_SHUNT_CONT = 0b101,
+  INA226_MODE_BUS_CONT = 0b110,
+  INA226_MODE_SHUNT_BUS_CONT = 0b111
+} ina226_mode_t;
+
+class INA226 {
+public:
+  bool begin(uint8_t address = 0x40);
+  bool configure(ina226_averages_t avg = INA226_AVERAGES_1,
+                 ina226_busConvTime_t busConvTime = INA226_BUS_CONV_TIME_1100US,
+                 ina226_shuntConvTime_t shuntConvTime = INA226_SHUNT_CONV_TIME_1100US,
+                 ina226_mode_t mode = INA226_MODE_SHUNT_BUS_CONT);
+  bool calibrate(float rShuntValue = 0.1, float iMaxExcepted = 2);
+
+  float readBusVoltage();
+  float readShuntVoltage();
+  float readShuntCurrent();
+  float readBusPower();
+
+  void enableConversionReadyAlert();
+  void setAlertLatch(bool latch);
+
+private:
+  uint8_t inaAddress = 0x40;
+  float rShunt = 0.1;
+};
+
+#endif // NATIVE_HAL_INA226_H
@@ -0,0 +1,44 @@
+// Host-side stand-in for the ESP32 Preferences (NVS) library (native env only).
+// Values live in memory for the life of the process; fake_nvs_write_count() in
+// hal_fake.h counts the writes that would have hit flash.
+
+#ifndef NATIVE_HAL_PREFERENCES_H
+#define NATIVE_HAL_PREFERENCES_H
+
+#include <Arduino.h>
+#include <string>
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end();
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putBytes(const char* key, const void* value, size_t len);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+  size_t getBytesLength(const char* key);
+
+  size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get_scalar(key, defaultValue); }
+  size_t putULong(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return get_scalar(key, defaultValue); }
+  size_t putInt(const char* key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+  int32_t getInt(const char* key, int32_t defaultValue = 0) { return get_scalar(key, defaultValue); }
+  size_t putBool(const char* key, bool value) { return putBytes(key, &value, sizeof(value)); }
+  bool getBool(const char* key, bool defaultValue = false) { return get_scalar(key, defaultValue); }
+
+private:
+  template <typename T> T get_scalar(const char* key, T defaultValue) {
+    T value;
+    return (getBytesLength(key) == sizeof(T) && getBytes(key, &value, sizeof(T)) == sizeof(T)) ? value : defaultValue;
+  }
+  std::string prefix(const char* key) const { return nameSpace + "/" + key; }
+
+  std::string nameSpace;
+  bool opened = false;
+  bool readOnly = false;
+};
+
+#endif // NATIVE_HAL_PREFERENCES_H
@@ -0,0 +1,73 @@
+// Host-side stand-in for knolleary/PubSubClient (native env only).
+// Publishes go to an in-memory broker that records the last payload per topic;
+// inbound messages are injected with fake_mqtt_deliver(). See hal_fake.h.
+
+#ifndef NATIVE_HAL_PUBSUBCLIENT_H
+#define NATIVE_HAL_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+#include <string>
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient : public Print {
+public:
+  PubSubClient();
+  PubSubClient(Client& client);
+  ~PubSubClient();
+
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setClient(Client& client) { (void)client; return *this; }
+  PubSubClient& setKeepAlive(uint16_t keepAlive) { (void)keepAlive; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t timeout) { (void)timeout; return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return bufferSize; }
+
+  bool connect(const char* id, const char* user, const char* pass,
+               const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage,
+               bool cleanSession = true);
+  void disconnect();
+  bool connected();
+  int state() { return connectionState; }
+  bool loop();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const char* payload, bool retained);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained);
+
+  bool beginPublish(const char* topic, unsigned int plength, bool retained);
+  int endPublish();
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+
+  bool subscribe(const char* topic, uint8_t qos = 0);
+  bool unsubscribe(const char* topic);
+
+  // Used by fake_mqtt_deliver() to hand an inbound message to the callback.
+  void deliver(const char* topic, const uint8_t* payload, unsigned int length);
+
+private:
+  MQTT_CALLBACK_SIGNATURE;
+  uint16_t bufferSize = 256;
+  int connectionState = MQTT_DISCONNECTED;
+  bool streaming = false;
+  bool streamRetained = false;
+  unsigned int streamLength = 0;  // Length promised in the packet header
+  std::string streamTopic;
+  std::string streamPayload;
+};
+
+#endif // NATIVE_HAL_PUBSUBCLIENT_H
@@ -0,0 +1,52 @@
+// Host-side stand-in for the ESP32 WiFi library (native env only).
+// The association state is driven by fake_wifi_set_connected() in hal_fake.h.
+
+#ifndef NATIVE_HAL_WIFI_H
+#define NATIVE_HAL_WIFI_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM
+} wifi_ps_type_t;
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t mode) { (void)mode; return true; }
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr);
+  wl_status_t status();
+  bool disconnect(bool wifioff = false);
+  bool reconnect();
+  bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+  bool setSleep(wifi_ps_type_t sleepType) { (void)sleepType; return true; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int8_t RSSI() { return -60; }
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Client {
+public:
+  void setConnectionTimeout(uint32_t milliseconds) { (void)milliseconds; }
+};
+
+#endif // NATIVE_HAL_WIFI_H
@@ -0,0 +1,37 @@
+// Host-side stand-in for the Arduino Wire (I2C) library (native env only).
+// Writes are counted, see fake_wire_bytes_written(). Addresses that have a
+// fake INA226 behind them answer register reads; everything else reads as 0.
+
+#ifndef NATIVE_HAL_WIRE_H
+#define NATIVE_HAL_WIRE_H
+
+#include <Arduino.h>
+
+#define I2C_BUFFER_LENGTH 128
+
+class TwoWire {
+public:
+  bool begin() { return true; }
+  bool begin(int sda, int scl, uint32_t frequency = 0) { (void)sda; (void)scl; (void)frequency; return true; }
+  bool setClock(uint32_t frequency) { (void)frequency; return true; }
+  void beginTransmission(uint16_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t quantity);
+  size_t requestFrom(uint16_t address, size_t size, bool sendStop = true);
+  uint8_t requestFrom(int address, int size) { return (uint8_t)requestFrom((uint16_t)address, (size_t)size, true); }
+  int available();
+  int read();
+
+private:
+  uint16_t txAddress = 0;
+  uint8_t txBuffer[I2C_BUFFER_LENGTH];
+  size_t txLength = 0;
+  uint8_t rxBuffer[I2C_BUFFER_LENGTH];
+  size_t rxLength = 0;
+  size_t rxIndex = 0;
+};
+
+extern TwoWire Wire;
+
+#endif // NATIVE_HAL_WIRE_H
@@ -0,0 +1,58 @@
+// Simulation controls for the native HAL.
+// The firmware never includes this file; it is used by the simulation entry
+// point (and anything else that drives the firmware off-target) to move the
+// fake clock, drive input pins, inject MQTT traffic and set sensor readings.
+
+#ifndef NATIVE_HAL_FAKE_H
+#define NATIVE_HAL_FAKE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+// --- Fake Clock ---
+void fake_clock_set_micros(uint64_t us);
+void fake_clock_advance_ms(unsigned long ms);
+void fake_clock_advance_us(unsigned long us);
+// Sets the wall clock time() returns from now on; it then advances with the
+// fake clock. An epoch before 2023 reads as "SNTP not synced yet".
+void fake_clock_set_epoch(time_t epoch);
+
+// --- Fake GPIO ---
+// Drives an input pin and fires its attached ISR if the edge matches.
+void fake_gpio_set(uint8_t pin, int level);
+// Reads back the level last written to an output pin.
+int fake_gpio_get(uint8_t pin);
+
+// --- Fake Serial ---
+// Serial output is discarded by default so long simulations stay fast.
+void fake_serial_echo(bool enabled);
+
+// --- Fake Wi-Fi ---
+void fake_wifi_set_connected(bool connected);
+
+// --- In-Memory MQTT Broker ---
+void fake_mqtt_set_broker_online(bool online);
+void fake_mqtt_deliver(const char* topic, const char* payload);
+unsigned long fake_mqtt_publish_count();
+unsigned long fake_mqtt_publish_bytes();
+// Last payload published on the topic, or nullptr if it was never published.
+const char* fake_mqtt_last_payload(const char* topic);
+void fake_mqtt_reset_counters();
+
+// --- Fake INA226 ---
+void fake_ina226_set(uint8_t address, float busVolts, float shuntAmps);
+unsigned long fake_ina226_read_count();
+// Models the shared ALERT line on `pin`. Until this is called every device
+// reports a conversion ready whenever MASK_ENABLE is read.
+void fake_ina226_set_alert_pin(uint8_t pin);
+// Completes a conversion: sets the device's CVRF and pulls the ALERT line low
+// until every flag has been read back.
+void fake_ina226_convert(uint8_t address);
+
+// --- In-Memory NVS ---
+unsigned long fake_nvs_write_count();
+
+// --- Fake I2C ---
+unsigned long fake_wire_bytes_written();
+
+#endif // NATIVE_HAL_FAKE_H
@@ -0,0 +1,203 @@
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include "hal_fake.h"
+
+// --- Fake Clock ---
+static uint64_t fakeMicros = 0;
+
+unsigned long millis() { return (unsigned long)(fakeMicros / 1000); }
+unsigned long micros() { return (unsigned long)fakeMicros; }
+void delay(unsigned long ms) { fakeMicros += (uint64_t)ms * 1000; }
+void delayMicroseconds(unsigned int us) { fakeMicros += us; }
+void yield() {}
+
+void fake_clock_set_micros(uint64_t us) { fakeMicros = us; }
+void fake_clock_advance_ms(unsigned long ms) { fakeMicros += (uint64_t)ms * 1000; }
+void fake_clock_advance_us(unsigned long us) { fakeMicros += us; }
+
+// --- CPU ---
+static const uint32_t FAKE_CPU_MHZ = 160;
+
+uint32_t getCpuFrequencyMhz() { return FAKE_CPU_MHZ; }
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+  return (uint32_t)(ns * FAKE_CPU_MHZ / 1000);
+}
+
+static const uint32_t FAKE_HEAP_BYTES = 320 * 1024;
+
+uint32_t EspClass::getFreeHeap() { return FAKE_HEAP_BYTES; }
+uint32_t EspClass::getMinFreeHeap() { return FAKE_HEAP_BYTES; }
+uint32_t EspClass::getMaxAllocHeap() { return FAKE_HEAP_BYTES; }
+
+// --- Time of Day ---
+// time() is replaced so a test can stand in for SNTP. Until an epoch is set
+// it returns the host's wall clock; afterwards it follows the fake clock.
+static bool fakeEpochSet = false;
+static time_t fakeEpoch = 0;
+static uint64_t fakeEpochMicros = 0;  // fakeMicros when the epoch was set
+
+void fake_clock_set_epoch(time_t epoch) {
+  fakeEpochSet = true;
+  fakeEpoch = epoch;
+  fakeEpochMicros = fakeMicros;
+}
+
+extern "C" time_t time(time_t* out) noexcept {
+  time_t now;
+  if (fakeEpochSet) {
+    now = fakeEpoch + (time_t)((fakeMicros - fakeEpochMicros) / 1000000);
+  } else {
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    now = wall.tv_sec;
+  }
+  if (out != nullptr) *out = now;
+  return now;
+}
+
+void configTzTime(const char* tz, const char* server1, const char* server2, const char* server3) {
+  (void)server1; (void)server2; (void)server3;
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+// --- Fake GPIO ---
+static const int FAKE_PIN_COUNT = 64;
+static uint8_t pinLevels[FAKE_PIN_COUNT];
+static uint8_t pinModes[FAKE_PIN_COUNT];
+static void (*pinIsr[FAKE_PIN_COUNT])(void);
+static int pinIsrMode[FAKE_PIN_COUNT];
+static bool interruptsEnabled = true;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= FAKE_PIN_COUNT) return;
+  pinModes[pin] = mode;
+  if (mode == INPUT_PULLUP) pinLevels[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < FAKE_PIN_COUNT) pinLevels[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  return (pin < FAKE_PIN_COUNT) ? pinLevels[pin] : LOW;
+}
+
+int digitalPinToInterrupt(uint8_t pin) { return pin; }
+
+void attachInterrupt(uint8_t interruptNum, void (*isr)(void), int mode) {
+  if (interruptNum >= FAKE_PIN_COUNT) return;
+  pinIsr[interruptNum] = isr;
+  pinIsrMode[interruptNum] = mode;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  if (interruptNum < FAKE_PIN_COUNT) pinIsr[interruptNum] = nullptr;
+}
+
+void noInterrupts() { interruptsEnabled = false; }
+void interrupts() { interruptsEnabled = true; }
+
+void fake_gpio_set(uint8_t pin, int level) {
+  if (pin >= FAKE_PIN_COUNT) return;
+  uint8_t previous = pinLevels[pin];
+  pinLevels[pin] = level ? HIGH : LOW;
+  if (pinIsr[pin] == nullptr || previous == pinLevels[pin] || !interruptsEnabled) return;
+
+  bool rising = (pinLevels[pin] == HIGH);
+  int mode = pinIsrMode[pin];
+  if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising)) {
+    pinIsr[pin]();
+  }
+}
+
+int fake_gpio_get(uint8_t pin) {
+  return (pin < FAKE_PIN_COUNT) ? pinLevels[pin] : LOW;
+}
+
+// --- Math Helpers ---
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static unsigned long randomState = 1;
+
+void randomSeed(unsigned long seed) { if (seed != 0) randomState = seed; }
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+  randomState = randomState * 1103515245UL + 12345UL;
+  return (long)((randomState >> 16) % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
+
+// --- String ---
+std::string String::format_integer(long long value, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  bool negative = value < 0 && base == 10;
+  unsigned long long magnitude = negative ? -(unsigned long long)value : (unsigned long long)value;
+  std::string digits;
+  do {
+    int digit = magnitude % base;
+    digits.insert(digits.begin(), (char)(digit < 10 ? '0' + digit : 'A' + digit - 10));
+    magnitude /= base;
+  } while (magnitude != 0);
+  if (negative) digits.insert(digits.begin(), '-');
+  return digits;
+}
+
+std::string String::format_float(double value, unsigned int decimals) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+  return buffer;
+}
+
+String IPAddress::toString() const {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets_[0], octets_[1], octets_[2], octets_[3]);
+  return String(buffer);
+}
+
+// --- Print / Serial ---
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) return 0;
+  return write((const uint8_t*)buffer, min((size_t)length, sizeof(buffer) - 1));
+}
+
+HardwareSerial Serial;
+static bool serialEcho = false;
+
+void fake_serial_echo(bool enabled) { serialEcho = enabled; }
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serialEcho) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (serialEcho) fwrite(buffer, 1, size, stdout);
+  return size;
+}
@@ -0,0 +1,137 @@
+#include <Adafruit_GFX.h>
+#include <Adafruit_SH110X.h>
+
+// --- Adafruit_GFX ---
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  for (;;) {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t i = 0; i < h; i++) drawFastHLine(x, y + i, w, color);
+}
+
+// Rounded corners are not worth simulating; the outline is close enough
+void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+  (void)r;
+  drawRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) {
+  (void)r;
+  fillRect(x, y, w, h, color);
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color) {
+  int16_t byteWidth = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7))) drawPixel(x + i, y + j, color);
+    }
+  }
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  int16_t byteWidth = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      bool set = bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7));
+      drawPixel(x + i, y + j, set ? color : bg);
+    }
+  }
+}
+
+// Classic 6x8 font metrics, scaled by the text size
+void Adafruit_GFX::getTextBounds(const char* string, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+  *x1 = x;
+  *y1 = y;
+  *w = strlen(string) * 6 * textsize;
+  *h = 8 * textsize;
+}
+
+void Adafruit_GFX::getTextBounds(const String& str, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+  getTextBounds(str.c_str(), x, y, x1, y1, w, h);
+}
+
+// Glyphs are not rendered; each character marks one pixel so text changes still
+// dirty the framebuffer.
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += 8 * textsize;
+  } else if (c != '\r') {
+    drawPixel(cursor_x + (c % (6 * textsize)), cursor_y, textcolor);
+    cursor_x += 6 * textsize;
+  }
+  return 1;
+}
+
+// --- GFXcanvas1 ---
+GFXcanvas1::GFXcanvas1(uint16_t w, uint16_t h) : Adafruit_GFX(w, h) {
+  buffer = (uint8_t*)calloc(((w + 7) / 8) * h, 1);
+}
+
+GFXcanvas1::~GFXcanvas1() { free(buffer); }
+
+void GFXcanvas1::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (buffer == nullptr || x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) return;
+  uint8_t* ptr = &buffer[(x / 8) + y * ((WIDTH + 7) / 8)];
+  if (color == 1) *ptr |= 0x80 >> (x & 7);
+  else if (color == 0) *ptr &= ~(0x80 >> (x & 7));
+  else *ptr ^= 0x80 >> (x & 7);
+}
+
+// --- Adafruit_SH1107 ---
+Adafruit_SH1107::Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire* twi, int8_t rst_pin, uint32_t preclk, uint32_t postclk)
+    : Adafruit_GFX(w, h) {
+  (void)twi; (void)rst_pin; (void)preclk; (void)postclk;
+}
+
+Adafruit_SH1107::~Adafruit_SH1107() { free(buffer); }
+
+bool Adafruit_SH1107::begin(uint8_t addr, bool reset) {
+  (void)addr;
+  (void)reset;
+  if (buffer == nullptr) buffer = (uint8_t*)malloc(WIDTH * ((HEIGHT + 7) / 8));
+  if (buffer == nullptr) return false;
+  clearDisplay();
+  return true;
+}
+
+void Adafruit_SH1107::display() {}
+
+void Adafruit_SH1107::clearDisplay() {
+  if (buffer != nullptr) memset(buffer, 0, WIDTH * ((HEIGHT + 7) / 8));
+}
+
+void Adafruit_SH1107::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (buffer == nullptr || x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) return;
+  uint8_t* ptr = &buffer[x + (y / 8) * WIDTH];
+  uint8_t bit = 1 << (y & 7);
+  if (color == SH110X_WHITE) *ptr |= bit;
+  else if (color == SH110X_BLACK) *ptr &= ~bit;
+  else *ptr ^= bit;
+}
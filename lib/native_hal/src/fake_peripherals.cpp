@@ -0,0 +1,167 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <WiFi.h>
+#include <INA226.h>
+#include <map>
+#include "hal_fake.h"
+
+// --- Fake I2C ---
+TwoWire Wire;
+static unsigned long wireBytesWritten = 0;
+
+// Implemented with the fake INA226 below.
+static bool fake_ina226_write(uint8_t address, const uint8_t* data, size_t length);
+static size_t fake_ina226_read(uint8_t address, uint8_t* data, size_t length);
+
+void TwoWire::beginTransmission(uint16_t address) {
+  txAddress = address;
+  txLength = 0;
+  wireBytesWritten++;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  (void)sendStop;
+  fake_ina226_write((uint8_t)txAddress, txBuffer, txLength);
+  return 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  wireBytesWritten++;
+  if (txLength < sizeof(txBuffer)) txBuffer[txLength++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t quantity) {
+  for (size_t i = 0; i < quantity; i++) write(data[i]);
+  return quantity;
+}
+
+size_t TwoWire::requestFrom(uint16_t address, size_t size, bool sendStop) {
+  (void)sendStop;
+  if (size > sizeof(rxBuffer)) size = sizeof(rxBuffer);
+  memset(rxBuffer, 0, size);
+  fake_ina226_read((uint8_t)address, rxBuffer, size);
+  rxLength = size;
+  rxIndex = 0;
+  return size;
+}
+
+int TwoWire::available() { return (int)(rxLength - rxIndex); }
+int TwoWire::read() { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+
+unsigned long fake_wire_bytes_written() { return wireBytesWritten; }
+
+// --- Fake Wi-Fi ---
+WiFiClass WiFi;
+static bool wifiConnected = true;
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase) {
+  (void)ssid;
+  (void)passphrase;
+  return status();
+}
+
+wl_status_t WiFiClass::status() { return wifiConnected ? WL_CONNECTED : WL_DISCONNECTED; }
+bool WiFiClass::disconnect(bool wifioff) { (void)wifioff; return true; }
+bool WiFiClass::reconnect() { return wifiConnected; }
+
+void fake_wifi_set_connected(bool connected) { wifiConnected = connected; }
+
+// --- Fake INA226 ---
+struct FakeIna226Reading {
+  float busVolts;
+  float shuntAmps;
+  float rShunt = 0.1f;
+  uint8_t registerPointer = 0;
+  bool conversionReady = false;  // CVRF, only modelled once an ALERT pin is set
+};
+
+static std::map<uint8_t, FakeIna226Reading> ina226Readings;
+static unsigned long ina226ReadCount = 0;
+static int ina226AlertPin = -1;  // Shared open-drain ALERT line, -1 if not modelled
+
+void fake_ina226_set(uint8_t address, float busVolts, float shuntAmps) {
+  FakeIna226Reading& reading = ina226Readings[address];
+  reading.busVolts = busVolts;
+  reading.shuntAmps = shuntAmps;
+}
+
+void fake_ina226_set_alert_pin(uint8_t pin) {
+  ina226AlertPin = pin;
+  fake_gpio_set(pin, HIGH);
+}
+
+void fake_ina226_convert(uint8_t address) {
+  auto it = ina226Readings.find(address);
+  if (it == ina226Readings.end() || ina226AlertPin < 0) return;
+  it->second.conversionReady = true;
+  fake_gpio_set(ina226AlertPin, LOW);
+}
+
+// Reading MASK_ENABLE clears CVRF; the line goes high once no device holds it
+static uint16_t read_mask_enable(FakeIna226Reading& reading) {
+  if (ina226AlertPin < 0) return 0x0008;  // Not modelled: every conversion is ready
+  uint16_t flags = reading.conversionReady ? 0x0008 : 0;
+  reading.conversionReady = false;
+  for (const auto& device : ina226Readings) {
+    if (device.second.conversionReady) return flags;
+  }
+  fake_gpio_set(ina226AlertPin, HIGH);
+  return flags;
+}
+
+static uint16_t fake_ina226_register(FakeIna226Reading& reading, uint8_t reg) {
+  switch (reg) {
+    case 0x01: return (uint16_t)(int16_t)lroundf(reading.shuntAmps * reading.rShunt / 0.0000025f);
+    case 0x02: return (uint16_t)lroundf(reading.busVolts / 0.00125f);
+    case 0x06: return read_mask_enable(reading);
+    default:   return 0;
+  }
+}
+
+static bool fake_ina226_write(uint8_t address, const uint8_t* data, size_t length) {
+  auto it = ina226Readings.find(address);
+  if (it == ina226Readings.end() || length == 0) return false;
+  it->second.registerPointer = data[0];
+  return true;
+}
+
+static size_t fake_ina226_read(uint8_t address, uint8_t* data, size_t length) {
+  auto it = ina226Readings.find(address);
+  if (it == ina226Readings.end() || length < 2) return 0;
+  uint16_t value = fake_ina226_register(it->second, it->second.registerPointer);
+  data[0] = (uint8_t)(value >> 8);
+  data[1] = (uint8_t)value;
+  ina226ReadCount++;
+  return 2;
+}
+
+unsigned long fake_ina226_read_count() { return ina226ReadCount; }
+
+bool INA226::begin(uint8_t address) { inaAddress = address; return true; }
+
+bool INA226::configure(ina226_averages_t avg, ina226_busConvTime_t busConvTime,
+                       ina226_shuntConvTime_t shuntConvTime, ina226_mode_t mode) {
+  (void)avg; (void)busConvTime; (void)shuntConvTime; (void)mode;
+  return true;
+}
+
+bool INA226::calibrate(float rShuntValue, float iMaxExcepted) {
+  (void)iMaxExcepted;
+  rShunt = rShuntValue;
+  ina226Readings[inaAddress].rShunt = rShuntValue;
+  return true;
+}
+
+void INA226::enableConversionReadyAlert() {}
+void INA226::setAlertLatch(bool latch) { (void)latch; }
+
+float INA226::readBusVoltage() { ina226ReadCount++; return ina226Readings[inaAddress].busVolts; }
+float INA226::readShuntCurrent() { ina226ReadCount++; return ina226Readings[inaAddress].shuntAmps; }
+float INA226::readShuntVoltage() { ina226ReadCount++; return ina226Readings[inaAddress].shuntAmps * rShunt; }
+
+float INA226::readBusPower() {
+  ina226ReadCount++;
+  const FakeIna226Reading& reading = ina226Readings[inaAddress];
+  return fabsf(reading.busVolts * reading.shuntAmps);
+}
@@ -0,0 +1,62 @@
+#include <Preferences.h>
+#include <map>
+#include <vector>
+#include "hal_fake.h"
+
+// --- In-Memory NVS ---
+static std::map<std::string, std::vector<uint8_t>> nvsStore;
+static unsigned long nvsWriteCount = 0;
+
+unsigned long fake_nvs_write_count() { return nvsWriteCount; }
+
+bool Preferences::begin(const char* name, bool readOnly) {
+  nameSpace = name;
+  this->readOnly = readOnly;
+  opened = true;
+  return true;
+}
+
+void Preferences::end() { opened = false; }
+
+bool Preferences::clear() {
+  if (!opened || readOnly) return false;
+  std::string start = nameSpace + "/";
+  for (std::map<std::string, std::vector<uint8_t>>::iterator it = nvsStore.begin(); it != nvsStore.end();) {
+    if (it->first.compare(0, start.size(), start) == 0) it = nvsStore.erase(it);
+    else ++it;
+  }
+  nvsWriteCount++;
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!opened || readOnly) return false;
+  nvsWriteCount++;
+  return nvsStore.erase(prefix(key)) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  return opened && nvsStore.count(prefix(key)) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!opened || readOnly) return 0;
+  const uint8_t* bytes = (const uint8_t*)value;
+  nvsStore[prefix(key)].assign(bytes, bytes + len);
+  nvsWriteCount++;
+  return len;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  if (!opened) return 0;
+  std::map<std::string, std::vector<uint8_t>>::const_iterator it = nvsStore.find(prefix(key));
+  if (it == nvsStore.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (!opened) return 0;
+  std::map<std::string, std::vector<uint8_t>>::const_iterator it = nvsStore.find(prefix(key));
+  return (it == nvsStore.end()) ? 0 : it->second.size();
+}
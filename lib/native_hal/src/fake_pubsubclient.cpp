@@ -0,0 +1,160 @@
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <map>
+#include <string>
+#include "hal_fake.h"
+
+// --- In-Memory Broker ---
+static bool brokerOnline = true;
+static std::map<std::string, std::string> lastPayloads;
+static unsigned long publishCount = 0;
+static unsigned long publishBytes = 0;
+static PubSubClient* activeClient = nullptr;
+
+static void record_publish(const char* topic, const uint8_t* payload, unsigned int length) {
+  lastPayloads[topic].assign((const char*)payload, length);
+  publishCount++;
+  publishBytes += length;
+}
+
+void fake_mqtt_set_broker_online(bool online) { brokerOnline = online; }
+unsigned long fake_mqtt_publish_count() { return publishCount; }
+unsigned long fake_mqtt_publish_bytes() { return publishBytes; }
+
+const char* fake_mqtt_last_payload(const char* topic) {
+  std::map<std::string, std::string>::const_iterator it = lastPayloads.find(topic);
+  return (it == lastPayloads.end()) ? nullptr : it->second.c_str();
+}
+
+void fake_mqtt_reset_counters() {
+  publishCount = 0;
+  publishBytes = 0;
+}
+
+void fake_mqtt_deliver(const char* topic, const char* payload) {
+  if (activeClient != nullptr) {
+    activeClient->deliver(topic, (const uint8_t*)payload, strlen(payload));
+  }
+}
+
+// --- PubSubClient ---
+PubSubClient::PubSubClient() { activeClient = this; }
+PubSubClient::PubSubClient(Client& client) { (void)client; activeClient = this; }
+PubSubClient::~PubSubClient() { if (activeClient == this) activeClient = nullptr; }
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  (void)domain;
+  (void)port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  this->callback = callback;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage,
+                           bool cleanSession) {
+  (void)id; (void)user; (void)pass; (void)willQos; (void)willRetain; (void)cleanSession;
+  if (brokerOnline && WiFi.status() == WL_CONNECTED) {
+    connectionState = MQTT_CONNECTED;
+    return true;
+  }
+  if (willTopic != nullptr && willMessage != nullptr) {
+    lastPayloads[willTopic] = willMessage;
+  }
+  connectionState = MQTT_CONNECT_FAILED;
+  return false;
+}
+
+void PubSubClient::disconnect() { connectionState = MQTT_DISCONNECTED; }
+
+bool PubSubClient::connected() {
+  if (connectionState == MQTT_CONNECTED && (!brokerOnline || WiFi.status() != WL_CONNECTED)) {
+    connectionState = MQTT_CONNECTION_LOST;
+  }
+  return connectionState == MQTT_CONNECTED;
+}
+
+bool PubSubClient::loop() { return connected(); }
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+  return publish(topic, payload, plength, false);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+  (void)retained;
+  if (!connected()) return false;
+  // Same limit as the real client: header + topic + payload must fit the buffer
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + plength > bufferSize) return false;
+  record_publish(topic, payload, plength);
+  return true;
+}
+
+bool PubSubClient::beginPublish(const char* topic, unsigned int plength, bool retained) {
+  if (!connected()) return false;
+  streaming = true;
+  streamRetained = retained;
+  streamLength = plength;
+  streamTopic = topic;
+  streamPayload.clear();
+  return true;
+}
+
+int PubSubClient::endPublish() {
+  if (!streaming) return 0;
+  streaming = false;
+  // The header already went out with the promised length; a payload of any
+  // other size corrupts the packet, so the broker never sees the message.
+  if (streamPayload.size() != streamLength) return 0;
+  record_publish(streamTopic.c_str(), (const uint8_t*)streamPayload.data(), streamPayload.size());
+  return 1;
+}
+
+size_t PubSubClient::write(uint8_t data) {
+  if (!streaming) return 0;
+  streamPayload.push_back((char)data);
+  return 1;
+}
+
+size_t PubSubClient::write(const uint8_t* buffer, size_t size) {
+  if (!streaming) return 0;
+  streamPayload.append((const char*)buffer, size);
+  return size;
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  (void)topic;
+  (void)qos;
+  return connected();
+}
+
+bool PubSubClient::unsubscribe(const char* topic) {
+  (void)topic;
+  return connected();
+}
+
+void PubSubClient::deliver(const char* topic, const uint8_t* payload, unsigned int length) {
+  if (!callback) return;
+  // The real client hands out a pointer into its receive buffer, which always has
+  // spare room after the payload; mirror that so callers see identical behaviour.
+  std::string topicCopy(topic);
+  std::string payloadCopy((const char*)payload, length);
+  payloadCopy.push_back('\0');
+  callback(&topicCopy[0], (uint8_t*)&payloadCopy[0], length);
+}
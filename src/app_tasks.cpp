@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include "app_tasks.h"
+#include "connections.h"
+#include "light_control.h"
+#include "power_monitor.h"
+#include "energy_counter.h"
+#include "battery_soc.h"
+#include "settings.h"
+#include "light_stats.h"
+#include "power_manager.h"
+#include "user_interface.h"
+#include "loop_profiler.h"
+
+// --- Task Passes ---
+// Tasks only talk through SPSC queues and Snapshot<T> values, so a slow MQTT
+// publish or OLED flush in a lower-priority task can never hold up the relay.
+// Snapshots are written by a higher-priority task than the ones reading them,
+// with one exception: the network task's own PROFILE_MQTT stats, which the UI
+// reads with Snapshot::try_read() so it never spins on a preempted writer.
+static void control_pass() {
+  static uint32_t lastPassStart = 0;
+  static bool havePass = false;
+  uint32_t passStart = profile_start();
+  if (havePass) profile_end(PROFILE_LOOP, lastPassStart);
+  lastPassStart = passStart;
+  havePass = true;
+
+  loop_light_control();
+  profile_end(PROFILE_LIGHTS, passStart);
+}
+
+// The INA226s and the OLED share the I2C bus; Wire serialises transactions
+// between this task and the UI task.
+static void sensor_pass() {
+  uint32_t passStart = profile_start();
+  loop_power_monitor();
+  loop_energy();
+  loop_battery_soc();
+  loop_settings();
+  loop_light_stats();
+  loop_power_manager();
+  profile_end(PROFILE_POWER, passStart);
+}
+
+static void ui_pass() {
+  loop_user_interface();
+}
+
+// The only task that touches the PubSubClient.
+static void network_pass() {
+  uint32_t passStart = profile_start();
+  loop_connections();
+  if (get_connection_state() == CONN_ONLINE) {
+    loop_light_publisher();
+    loop_power_publisher();
+    loop_energy_publisher();
+    loop_battery_publisher();
+    loop_light_stats_publisher();
+    loop_power_manager_publisher();
+  }
+  profile_end(PROFILE_MQTT, passStart);
+  loop_profiler();
+}
+
+// --- Task Layout ---
+struct TaskSpec {
+  const char* name;
+  void (*pass)();
+  uint32_t stackBytes;
+  unsigned priority;
+  uint32_t periodMs;
+};
+
+// Highest priority first. The saving power modes stretch every period by
+// get_task_period_scale() so light sleep gets longer stretches.
+static const TaskSpec TASKS[] = {
+  {"control", control_pass, 3072, 5, 10},
+  {"sensor", sensor_pass, 4096, 4, 5},
+  {"ui", ui_pass, 4096, 2, 10},
+  {"network", network_pass, 6144, 1, 10},
+};
+
+#ifdef NATIVE_BUILD
+
+void setup_tasks() {}
+
+void loop_tasks() {
+  for (const TaskSpec& task : TASKS) task.pass();
+}
+
+#else
+
+static void run_task(void* parameter) {
+  const TaskSpec* task = (const TaskSpec*)parameter;
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    task->pass();
+    const TickType_t period = pdMS_TO_TICKS(task->periodMs * get_task_period_scale());
+    // After an overrun, restart the cadence instead of running a burst of
+    // back-to-back passes to catch up
+    if (xTaskDelayUntil(&lastWake, period) == pdFALSE) lastWake = xTaskGetTickCount();
+  }
+}
+
+void setup_tasks() {
+  for (const TaskSpec& task : TASKS) {
+    if (xTaskCreate(run_task, task.name, task.stackBytes, (void*)&task, task.priority, nullptr) != pdPASS) {
+      Serial.print("Failed to start task ");
+      Serial.println(task.name);
+    }
+  }
+}
+
+void loop_tasks() {
+  // Everything runs in the tasks above; the Arduino loop task is not needed
+  vTaskDelete(nullptr);
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include "battery_soc.h"
+#include "connections.h"
+#include "snapshot.h"
+#include "text_format.h"
+#include "config.h"
+
+// --- Open-Circuit Voltage Curves ---
+// Rested pack voltage against state of charge, ascending. Between points the
+// curve is linear.
+struct OcvPoint {
+  uint16_t millivolts;
+  uint16_t socPermille;
+};
+
+static const OcvPoint LEAD_ACID_CURVE[] = {
+  {11310, 0}, {11510, 100}, {11660, 200}, {11810, 300}, {11960, 400}, {12100, 500},
+  {12240, 600}, {12370, 700}, {12500, 800}, {12620, 900}, {12730, 1000},
+};
+
+static const OcvPoint LIFEPO4_CURVE[] = {
+  {10000, 0}, {12000, 90}, {12500, 140}, {12800, 170}, {12900, 200}, {13000, 300},
+  {13100, 400}, {13200, 700}, {13300, 900}, {13400, 990}, {13600, 1000},
+};
+
+struct ChemistryProfile {
+  const OcvPoint* curve;
+  uint8_t curvePoints;
+  // Terminal voltage a charge has to reach before the tail current can mark
+  // the battery full. It sits below the absorption voltage at any temperature,
+  // so the full-charge anchor needs no temperature compensation: the tapering
+  // current, not the voltage, decides when the battery is full.
+  uint16_t fullMillivolts;
+  uint8_t chargeEfficiencyPercent;  // Share of the charge going in that is stored
+};
+
+static const ChemistryProfile CHEMISTRY_PROFILES[] = {
+  {LEAD_ACID_CURVE, sizeof(LEAD_ACID_CURVE) / sizeof(LEAD_ACID_CURVE[0]), 13800, 90},  // BATTERY_LEAD_ACID
+  {LIFEPO4_CURVE, sizeof(LIFEPO4_CURVE) / sizeof(LIFEPO4_CURVE[0]), 13800, 99},        // BATTERY_LIFEPO4
+};
+
+// A rest reading only corrects the count where the curve is steep enough for
+// a few mV of error to matter little; on LiFePO4's flat middle it would not.
+static const uint32_t OCV_MIN_SLOPE_MV_PER_PERCENT = 8;
+
+// --- Fixed-Point Charge ---
+// Like the energy counters, trapezoids are summed without the final halving:
+// the charge is in units of 2 mA*ms. 100 Ah is 7.2e11 of them.
+static const int64_t HALF_UNITS_PER_MAH = 2LL * 3600 * 1000;
+
+// Smoothing for the time estimates: each sample moves the average 1/256 of the
+// way, about a minute at the 250 ms sample rate. Kept in mA/256.
+static const int32_t CURRENT_AVERAGE_SCALE = 256;
+
+// Saved to NVS as one blob; bump the version when the layout changes
+struct BatteryStore {
+  uint32_t version;
+  uint32_t capacityMah;  // A restored charge is only trusted for the same battery
+  int64_t charge;
+  uint8_t synced;
+  int16_t lastFullDriftPermille;
+};
+
+static const uint32_t BATTERY_STORE_VERSION = 1;
+static Preferences batteryPrefs;
+
+// --- Estimator State (sensor task) ---
+static const ChemistryProfile& profile = CHEMISTRY_PROFILES[BATTERY_CHEMISTRY];
+static int64_t capacity = 0;  // BATTERY_CAPACITY_MAH in charge units
+static int64_t charge = 0;
+static bool haveCharge = false;  // Restored from NVS or guessed from the first sample
+static bool synced = false;
+static int16_t lastFullDriftPermille = 0;
+
+static int32_t lastCurrentMa = 0;
+static unsigned long lastSampleTime = 0;
+static bool haveLastSample = false;
+static int32_t averageCurrent = 0;  // mA * CURRENT_AVERAGE_SCALE
+
+static bool resting = false;
+static unsigned long restStartTime = 0;
+static bool topping = false;        // At full voltage on a tail current
+static unsigned long toppingStartTime = 0;
+static bool fullApplied = false;    // Anchored at full since the last discharge
+
+static unsigned long lastBatterySaveTime = 0;
+
+static Snapshot<BatteryState> stateSnapshot;
+static unsigned long lastBatteryPublishTime = 0;  // Network task
+
+/**
+ * @brief Looks a rested voltage up on the chemistry's curve.
+ * @param socPermille Set to the interpolated state of charge.
+ * @return True if the curve is steep enough there to trust the result.
+ */
+static bool ocv_lookup(int32_t millivolts, uint16_t& socPermille) {
+  const OcvPoint* curve = profile.curve;
+  if (millivolts <= curve[0].millivolts) {
+    socPermille = curve[0].socPermille;
+    return true;
+  }
+  for (uint8_t i = 1; i < profile.curvePoints; i++) {
+    const OcvPoint& low = curve[i - 1];
+    const OcvPoint& high = curve[i];
+    if (millivolts > high.millivolts) continue;
+    uint32_t spanMv = high.millivolts - low.millivolts;
+    uint32_t spanPermille = high.socPermille - low.socPermille;
+    socPermille = low.socPermille + (uint32_t)(millivolts - low.millivolts) * spanPermille / spanMv;
+    return spanMv * 10 >= OCV_MIN_SLOPE_MV_PER_PERCENT * spanPermille;
+  }
+  socPermille = curve[profile.curvePoints - 1].socPermille;
+  return true;
+}
+
+static uint16_t soc_permille() {
+  return (uint16_t)(charge * 1000 / capacity);
+}
+
+static void set_soc(uint16_t socPermille) {
+  charge = capacity * socPermille / 1000;
+}
+
+static void save_battery() {
+  BatteryStore store = {BATTERY_STORE_VERSION, BATTERY_CAPACITY_MAH, charge, synced, lastFullDriftPermille};
+  batteryPrefs.putBytes("store", &store, sizeof(store));
+  lastBatterySaveTime = millis();
+}
+
+static void publish_state() {
+  BatteryState state;
+  state.valid = haveCharge;
+  state.synced = synced;
+  state.socPermille = soc_permille();
+  state.remainingMah = (uint32_t)(charge / HALF_UNITS_PER_MAH);
+  state.averageCurrentMa = averageCurrent / CURRENT_AVERAGE_SCALE;
+  state.minutesToEmpty = BATTERY_TIME_UNKNOWN;
+  state.minutesToFull = BATTERY_TIME_UNKNOWN;
+  if (state.averageCurrentMa < -(int32_t)BATTERY_REST_CURRENT_MA) {
+    state.minutesToEmpty = (uint32_t)((uint64_t)state.remainingMah * 60 / (uint32_t)(-state.averageCurrentMa));
+  } else if (state.averageCurrentMa > (int32_t)BATTERY_REST_CURRENT_MA) {
+    uint32_t storedRate = (uint32_t)state.averageCurrentMa * profile.chargeEfficiencyPercent;
+    state.minutesToFull = (uint32_t)((uint64_t)(BATTERY_CAPACITY_MAH - state.remainingMah) * 6000 / storedRate);
+  }
+  state.lastFullDriftPermille = lastFullDriftPermille;
+  stateSnapshot.publish(state);
+}
+
+void setup_battery_soc() {
+  capacity = (int64_t)BATTERY_CAPACITY_MAH * HALF_UNITS_PER_MAH;
+
+  BatteryStore store;
+  batteryPrefs.begin("battery", false);
+  size_t length = batteryPrefs.getBytesLength("store");
+  if (length == sizeof(store) && batteryPrefs.getBytes("store", &store, sizeof(store)) == sizeof(store) &&
+      store.version == BATTERY_STORE_VERSION && store.capacityMah == BATTERY_CAPACITY_MAH &&
+      store.charge >= 0 && store.charge <= capacity) {
+    charge = store.charge;
+    synced = store.synced;
+    lastFullDriftPermille = store.lastFullDriftPermille;
+    haveCharge = true;
+    Serial.println("Battery charge restored from NVS.");
+  }
+  lastBatterySaveTime = millis();
+  lastBatteryPublishTime = millis();
+  publish_state();
+}
+
+// Re-reads the state of charge off the curve after every BATTERY_REST_TIME of
+// rest; the longer the rest, the closer the voltage is to open-circuit.
+static void check_rest(unsigned long now, int32_t millivolts, int32_t currentMa) {
+  if (abs(currentMa) > (int32_t)BATTERY_REST_CURRENT_MA) {
+    resting = false;
+    return;
+  }
+  if (!resting) {
+    resting = true;
+    restStartTime = now;
+    return;
+  }
+  if (now - restStartTime < BATTERY_REST_TIME) return;
+  restStartTime = now;
+
+  uint16_t ocvPermille;
+  if (ocv_lookup(millivolts, ocvPermille)) {
+    set_soc(ocvPermille);
+    synced = true;
+  }
+}
+
+// A charge that has tapered to the tail current at full voltage has filled the
+// battery. Whatever the count says then is its accumulated drift.
+static void check_full(unsigned long now, int32_t millivolts, int32_t currentMa) {
+  if (currentMa < -(int32_t)BATTERY_REST_CURRENT_MA) fullApplied = false;
+
+  if (millivolts < profile.fullMillivolts || currentMa <= 0 || currentMa > (int32_t)BATTERY_FULL_TAIL_CURRENT_MA) {
+    topping = false;
+    return;
+  }
+  if (!topping) {
+    topping = true;
+    toppingStartTime = now;
+    return;
+  }
+  if (fullApplied || now - toppingStartTime < BATTERY_FULL_HOLD_TIME) return;
+
+  lastFullDriftPermille = (int16_t)(soc_permille() - 1000);
+  charge = capacity;
+  synced = true;
+  fullApplied = true;
+  save_battery();
+}
+
+void battery_record_sample(float busVoltage, float current) {
+  unsigned long now = millis();
+  int32_t millivolts = lroundf(busVoltage * 1000.0f);
+  int32_t currentMa = lroundf(current);
+
+  if (!haveCharge) {
+    // Best guess until the battery rests or reaches full
+    uint16_t ocvPermille;
+    ocv_lookup(millivolts, ocvPermille);
+    set_soc(ocvPermille);
+    haveCharge = true;
+  }
+
+  if (haveLastSample) {
+    // Unsigned subtraction keeps dt correct across the millis() wraparound
+    int64_t dt = (int64_t)(unsigned long)(now - lastSampleTime);
+    int64_t delta = ((int64_t)lastCurrentMa + currentMa) * dt;
+    if (delta > 0) delta = delta * profile.chargeEfficiencyPercent / 100;
+    charge += delta;
+    if (charge < 0) charge = 0;
+    if (charge > capacity) charge = capacity;
+    averageCurrent += (currentMa * CURRENT_AVERAGE_SCALE - averageCurrent) / CURRENT_AVERAGE_SCALE;
+  } else {
+    averageCurrent = currentMa * CURRENT_AVERAGE_SCALE;
+  }
+  lastCurrentMa = currentMa;
+  lastSampleTime = now;
+  haveLastSample = true;
+
+  check_rest(now, millivolts, currentMa);
+  check_full(now, millivolts, currentMa);
+  publish_state();
+}
+
+void loop_battery_soc() {
+  if (haveCharge && millis() - lastBatterySaveTime >= BATTERY_SAVE_INTERVAL) save_battery();
+}
+
+BatteryState get_battery_state() {
+  return stateSnapshot.read();
+}
+
+// --- Network Side ---
+static void append_hours(TextBuffer& payload, uint32_t minutes) {
+  if (minutes == BATTERY_TIME_UNKNOWN) payload.append("null");
+  else payload.append_fixed(minutes / 60.0f, 1);
+}
+
+void loop_battery_publisher() {
+  if (millis() - lastBatteryPublishTime < BATTERY_PUBLISH_INTERVAL) return;
+  lastBatteryPublishTime = millis();
+
+  BatteryState state = get_battery_state();
+  if (!state.valid) return;
+
+  char buffer[192];
+  TextBuffer payload(buffer, sizeof(buffer));
+  payload.append("{\"soc_pct\":").append_fixed(state.socPermille / 10.0f, 1);
+  payload.append(",\"remaining_ah\":").append_fixed(state.remainingMah / 1000.0f, 2);
+  payload.append(",\"current_ma\":").append_signed(state.averageCurrentMa);
+  payload.append(",\"tte_h\":");
+  append_hours(payload, state.minutesToEmpty);
+  payload.append(",\"ttf_h\":");
+  append_hours(payload, state.minutesToFull);
+  payload.append(",\"synced\":").append(state.synced ? "true" : "false");
+  payload.append(",\"full_drift_pct\":").append_fixed(state.lastFullDriftPermille / 10.0f, 1);
+  payload.append('}');
+  client.publish(MQTT_TOPIC_BATTERY_STATE, buffer, true);
+}
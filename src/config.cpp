@@ -16,6 +16,9 @@ const int SCREEN_WIDTH = 128;
 const int SCREEN_HEIGHT = 128;
 const int OLED_RESET = -1;
 const int OLED_I2C_ADDRESS = 0x3C;
+const int OLED_COLUMN_OFFSET = 0; // SH1107 RAM column of the first visible pixel
+const uint8_t OLED_CONTRAST = 0x2F;      // Normal brightness, the driver's power-on value
+const uint8_t OLED_DIM_CONTRAST = 0x01;  // After DISPLAY_DIM_TIMEOUT without activity
 
 // --- Wi-Fi Credentials ---
 const char* WIFI_SSID = "M&M Motors";
@@ -26,6 +29,9 @@ const char* MQTT_SERVER = "192.168.0.70";
 const char* MQTT_USER = "mqtt_user";
 const char* MQTT_PASSWORD = "mqtt_user3700";
 const char* DEVICE_ID = "shed_esp32_c6_01";
+const char* MQTT_CLIENT_ID = "ESP32-XIAOC6-ShedMonitor";
+const uint16_t MQTT_PORT = 1883;
+const uint16_t MQTT_BUFFER_SIZE = 640; // Largest non-streamed publish (loop profile up to 575 B) plus topic
 
 // --- MQTT Topics ---
 const char* MQTT_BASE_TOPIC = "shed/monitor";
@@ -42,12 +48,22 @@ const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_BASE = "shed/monitor/light/manual_time
 const char* MQTT_TOPIC_POWER_CH1_STATE = "shed/monitor/power/ch1";
 const char* MQTT_TOPIC_POWER_CH2_STATE = "shed/monitor/power/ch2";
 const char* MQTT_TOPIC_POWER_CH3_STATE = "shed/monitor/power/ch3";
+const char* MQTT_TOPIC_POWER_STATE = "shed/monitor/power";
+const char* MQTT_TOPIC_ENERGY_CH1_STATE = "shed/monitor/energy/ch1";
+const char* MQTT_TOPIC_ENERGY_CH2_STATE = "shed/monitor/energy/ch2";
+const char* MQTT_TOPIC_ENERGY_CH3_STATE = "shed/monitor/energy/ch3";
 
 // --- Topics for functions to address
 const char* MQTT_TOPIC_LIGHT_MOTION_TIMER_STATE = "shed/monitor/light/motion_timer/state";
 const char* MQTT_TOPIC_LIGHT_MOTION_TIMER_SET = "shed/monitor/light/motion_timer/set";
 const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_STATE = "shed/monitor/light/manual_timer/state";
 const char* MQTT_TOPIC_LIGHT_MANUAL_TIMER_SET = "shed/monitor/light/manual_timer/set";
+const char* MQTT_TOPIC_DIAGNOSTICS_LOOP = "shed/monitor/diagnostics/loop";         // Loop profiler summary
+const char* MQTT_TOPIC_HISTORY_GET = "shed/monitor/history/get";                   // Query: "<channel> <1s|1m|15m>"
+const char* MQTT_TOPIC_HISTORY_STATE = "shed/monitor/history";                     // Reply to a history query
+const char* MQTT_TOPIC_LIGHT_STATS_STATE = "shed/monitor/light/stats";             // Relay and occupancy statistics
+const char* MQTT_TOPIC_DIAGNOSTICS_POWER = "shed/monitor/diagnostics/power";       // Power mode and the controller's own draw
+const char* MQTT_TOPIC_BATTERY_STATE = "shed/monitor/battery";                     // State of charge and time to empty/full
 
 // --- MQTT Payloads ---
 const char* MQTT_PAYLOAD_ONLINE = "online";
@@ -60,12 +76,66 @@ const uint8_t INA226_CH3_ADDRESS = 0x44; // Output
 const float INA226_CH1_SHUNT = 0.01;
 const float INA226_CH2_SHUNT = 0.01;
 const float INA226_CH3_SHUNT = 0.01;
+const bool INA226_USE_ALERT_PIN = false; // Set once the ALERT lines are wired up; polls otherwise
+const int INA226_ALERT_PIN = 0;          // D0 is GPIO0
+const PowerDeadband POWER_DEADBANDS[3] = {
+  // V abs, V %,  mA abs, mA %, mW abs, mW %
+  {  0.05,  0.5,  20.0,   2.0,  200.0,  2.0 },  // Solar Panel
+  {  0.02,  0.2,  10.0,   2.0,  100.0,  2.0 },  // Battery
+  {  0.05,  0.5,  10.0,   2.0,  100.0,  2.0 },  // Load
+};
+const unsigned long POWER_PUBLISH_HEARTBEAT = 60000; // Republish unchanged channels at least once a minute
+const PowerTelemetryMode POWER_TELEMETRY_MODE = POWER_TELEMETRY_PER_CHANNEL;
+
+// --- Power Management ---
+const int POWER_BATTERY_CHANNEL = 2;                   // The battery the controller runs from
+const int SELF_POWER_CHANNEL = 0;                      // Channel whose shunt carries only the controller's supply, 0 if none
+const uint8_t POWER_SAVE_BELOW_PERCENT = 75;           // State of charge (battery_soc.h), so any BATTERY_CHEMISTRY
+const uint8_t POWER_LOW_BELOW_PERCENT = 50;
+const uint8_t POWER_MODE_HYSTERESIS_PERCENT = 5;       // Extra margin needed to leave a deeper mode
+const unsigned long POWER_MODE_CHECK_INTERVAL = 30000; // How often the mode is reconsidered
+const unsigned long POWER_MANAGER_PUBLISH_INTERVAL = 60000;
+
+// --- Battery State of Charge ---
+const BatteryChemistry BATTERY_CHEMISTRY = BATTERY_LEAD_ACID;
+const uint32_t BATTERY_CAPACITY_MAH = 100000;           // Usable capacity at the 20-hour rate
+const uint32_t BATTERY_REST_CURRENT_MA = 100;           // Below this either way the battery counts as resting
+const unsigned long BATTERY_REST_TIME = 1800000;        // Rest needed before the voltage is read as open-circuit
+const uint32_t BATTERY_FULL_TAIL_CURRENT_MA = 2000;     // Charge current that has tapered below this at full voltage...
+const unsigned long BATTERY_FULL_HOLD_TIME = 120000;    // ...for this long means the battery is full
+const unsigned long BATTERY_PUBLISH_INTERVAL = 60000;
+const unsigned long BATTERY_SAVE_INTERVAL = 1800000;    // Charge to NVS every 30 minutes (flash wear)
 
 // --- Application Logic Constants ---
-unsigned long MOTION_TIMER_DURATION = 10000;      // 10 seconds
-unsigned long MANUAL_TIMER_DURATION = 300000;     // 5 minutes (300,000 ms)
-const int NUM_MODES = 5;
 const unsigned long INACTIVITY_TIMEOUT = 30000;
-const int DISPLAY_UPDATE_INTERVAL = 100;
+const int DISPLAY_UPDATE_INTERVAL = 100;              // Frame period while someone is around (10 Hz)
+const int DISPLAY_IDLE_UPDATE_INTERVAL = 1000;        // Frame period once INACTIVITY_TIMEOUT has passed
+const unsigned long DISPLAY_DIM_TIMEOUT = 60000;      // No motion or input for this long dims the panel
+const unsigned long DISPLAY_SLEEP_TIMEOUT = 300000;   // ...and this long switches it off
+const unsigned long BUTTON_DEBOUNCE_MS = 30;       // A level must hold this long, after its last edge, to count
+const unsigned long BUTTON_DOUBLE_CLICK_MS = 300;  // Max gap between the clicks of a double click
+const unsigned long BUTTON_LONG_PRESS_MS = 700;
+const unsigned long BUTTON_REPEAT_MS = 250;        // Hold-repeat rate after a long press
 const bool PUBLISH_DISCOVERY = true; // Set to 'false' to prevent publishing
+const unsigned long PROFILER_REPORT_INTERVAL = 30000; // Loop timing window, published at the end of each
+
+// --- Energy Counters ---
+const unsigned long ENERGY_PUBLISH_INTERVAL = 60000; // Wh/Ah counters to MQTT once a minute
+const unsigned long ENERGY_SAVE_INTERVAL = 600000;   // Counters to NVS every 10 minutes (flash wear)
+const char* NTP_SERVER = "pool.ntp.org";
+const char* NTP_TIMEZONE = "GMT0BST,M3.5.0/1,M10.5.0";   // POSIX TZ, sets local midnight for daily counters
+
+// --- Settings ---
+const unsigned long SETTINGS_WRITE_DELAY = 5000;   // Quiet time before a changed setting goes to NVS
+
+// --- Light Statistics ---
+const unsigned long LIGHT_STATS_PUBLISH_INTERVAL = 60000;   // Summary to MQTT once a minute
+const unsigned long LIGHT_STATS_SAVE_INTERVAL = 1800000;    // 2 KB of buckets to NVS every 30 minutes (flash wear)
+
+// --- Connection Manager ---
+const unsigned long WIFI_REJOIN_INTERVAL = 30000;     // Kick the Wi-Fi driver if still down after this
+const unsigned long RECONNECT_BACKOFF_MIN_MS = 1000;  // First MQTT retry delay (before jitter)
+const unsigned long RECONNECT_BACKOFF_MAX_MS = 60000; // Backoff ceiling
+const uint32_t MQTT_CONNECT_TIMEOUT_MS = 2000;        // TCP connect timeout
+const uint16_t MQTT_SOCKET_TIMEOUT_S = 2;             // CONNACK/read timeout inside client.connect()
 
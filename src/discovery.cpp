@@ -0,0 +1,376 @@
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "discovery.h"
+#include "connections.h"
+#include "power_monitor.h"
+#include "config.h"
+
+// --- Descriptor Tables ---
+// Everything below is constexpr and lives in flash. Topics that are defined
+// in config.cpp are referenced through their address, so the tables stay
+// constant while the strings keep a single definition.
+
+constexpr const char* RELATIVE_STATE_TOPIC = "~/state";
+constexpr const char* RELATIVE_SWITCH_TOPIC = "~/switch";
+constexpr const char* RELATIVE_SET_TOPIC = "~/set";
+
+// A one-off entity. nullptr fields are left out of the payload; a range is
+// only written when min < max.
+struct EntityDescriptor {
+  const char* key;
+  const char* name;
+  const char* platform;
+  const char* deviceClass;
+  const char* unit;
+  const char* uniqueId;
+  const char* objectId;
+  const char* const* baseTopic;
+  const char* const* stateTopic;
+  const char* const* commandTopic;
+  const char* payloadOn;
+  const char* payloadOff;
+  int16_t min;
+  int16_t max;
+};
+
+constexpr EntityDescriptor ENTITIES[] = {
+  // Software-based occupancy sensor (timer-based)
+  {"shed_monitor_occupancy", "Shed Occupancy", "binary_sensor", "occupancy", nullptr,
+   "shed_esp32_pir_occupancy", "shed_occupancy",
+   nullptr, &MQTT_TOPIC_OCCUPANCY_STATE, nullptr, "on", "off", 0, 0},
+  // Physical PIR motion sensor
+  {"shed_monitor_motion", "Shed Motion", "binary_sensor", "motion", nullptr,
+   "shed_esp32_pir_motion", "shed_motion",
+   nullptr, &MQTT_TOPIC_MOTION_STATE, nullptr, "on", "off", 0, 0},
+  // Light (relay)
+  {"shed_monitor_light", "Shed Light", "light", nullptr, nullptr,
+   "shed_esp32_light", "shed_light",
+   &MQTT_TOPIC_LIGHT_BASE, &RELATIVE_STATE_TOPIC, &RELATIVE_SWITCH_TOPIC, nullptr, nullptr, 0, 0},
+  // Motion timer (for the light)
+  {"shed_monitor_light_motion_timer", "Shed Motion Timer", "number", nullptr, "s",
+   "shed_esp32_light_motion_timer", "shed_light_motion_timer",
+   &MQTT_TOPIC_LIGHT_MOTION_TIMER_BASE, &RELATIVE_STATE_TOPIC, &RELATIVE_SET_TOPIC, nullptr, nullptr, 10, 3600},
+  // Manual override timer (for the light)
+  {"shed_monitor_light_override_timer", "Shed Override Timer", "number", nullptr, "s",
+   "shed_esp32_light_override_timer", "shed_light_override_timer",
+   &MQTT_TOPIC_LIGHT_MANUAL_TIMER_BASE, &RELATIVE_STATE_TOPIC, &RELATIVE_SET_TOPIC, nullptr, nullptr, 10, 3600},
+};
+
+// One INA226 channel. Per-channel sensors take their names, ids and state
+// topic from here, so adding a channel is one row.
+struct ChannelDescriptor {
+  const char* label;        // "Solar Panel" -> "Solar Panel Voltage"
+  const char* objectName;   // "solar_panel" -> "shed_solar_panel_voltage"
+  const char* const* powerTopic;
+  const char* const* energyTopic;
+  const char* icon;         // For sensors that have no icon of their own
+};
+
+constexpr ChannelDescriptor CHANNELS[3] = {
+  {"Solar Panel", "solar_panel", &MQTT_TOPIC_POWER_CH1_STATE, &MQTT_TOPIC_ENERGY_CH1_STATE, "mdi:solar-power-variant"},
+  {"Battery", "battery", &MQTT_TOPIC_POWER_CH2_STATE, &MQTT_TOPIC_ENERGY_CH2_STATE, "mdi:battery"},
+  {"Load", "load", &MQTT_TOPIC_POWER_CH3_STATE, &MQTT_TOPIC_ENERGY_CH3_STATE, "mdi:power-plug"},
+};
+
+constexpr uint8_t ALL_CHANNELS = 0b111;
+constexpr uint8_t BATTERY_CHANNEL = 0b010;
+
+// A sensor repeated on every channel in its mask. Keys and ids are built as
+// shed_monitor_power_ch<N>_<suffix>, shed_esp32_power_ch<N>_<suffix> and
+// shed_<objectName>_<suffix>.
+struct ChannelSensorDescriptor {
+  const char* suffix;
+  const char* label;
+  const char* valueField;   // Field of the channel's JSON state payload
+  int8_t packedField;       // Float index in the channel's packed slot; -1 if none
+  const char* deviceClass;
+  const char* unit;
+  const char* stateClass;
+  const char* icon;         // nullptr: use the channel's icon
+  uint8_t channels;         // Bit n set: present on channel n + 1
+};
+
+constexpr ChannelSensorDescriptor POWER_SENSORS[] = {
+  {"voltage", "Voltage", "bus_voltage", 0, "voltage", "V", "measurement", "mdi:flash", ALL_CHANNELS},
+  {"current", "Current", "current", 1, "current", "mA", "measurement", "mdi:current-dc", ALL_CHANNELS},
+  {"power", "Power", "power", 2, "power", "mW", "measurement", nullptr, ALL_CHANNELS},
+};
+
+constexpr ChannelSensorDescriptor ENERGY_SENSORS[] = {
+  {"wh_day", "Energy Today", "wh_day", -1, "energy", "Wh", "total_increasing", "mdi:lightning-bolt", ALL_CHANNELS},
+  {"wh_week", "Energy This Week", "wh_week", -1, "energy", "Wh", "total_increasing", "mdi:lightning-bolt", ALL_CHANNELS},
+  {"wh_total", "Energy Total", "wh_total", -1, "energy", "Wh", "total_increasing", "mdi:lightning-bolt", ALL_CHANNELS},
+  {"ah_total", "Charge Total", "ah_total", -1, nullptr, "Ah", "total_increasing", "mdi:battery-charging", ALL_CHANNELS},
+  // The battery is the only channel that runs both ways
+  {"wh_out_total", "Discharge Energy Total", "wh_out_total", -1, "energy", "Wh", "total_increasing", "mdi:lightning-bolt", BATTERY_CHANNEL},
+  {"ah_out_total", "Discharge Total", "ah_out_total", -1, nullptr, "Ah", "total_increasing", "mdi:battery-charging", BATTERY_CHANNEL},
+};
+
+// Sensors read from one JSON topic per group: the relay and occupancy
+// statistics, and the battery state of charge. Keys and ids are built as
+// shed_monitor_<group>_<suffix>, shed_esp32_<group>_<suffix> and
+// shed_<group>_<suffix>.
+struct StatsSensorDescriptor {
+  const char* suffix;
+  const char* name;
+  const char* valueField;   // Field of the stats JSON payload
+  const char* deviceClass;
+  const char* unit;
+  const char* stateClass;
+  const char* icon;
+};
+
+constexpr StatsSensorDescriptor STATS_SENSORS[] = {
+  {"on_time_24h", "Shed Light On Time 24h", "on_h_24h", "duration", "h", "measurement", "mdi:lightbulb-on"},
+  {"switches_24h", "Shed Light Switches 24h", "switches_24h", nullptr, nullptr, "measurement", "mdi:counter"},
+  {"motion_rate_24h", "Shed Motion Rate 24h", "motion_per_h_24h", nullptr, "events/h", "measurement", "mdi:motion-sensor"},
+  {"occupancy_24h", "Shed Occupancy 24h", "occupancy_pct_24h", nullptr, "%", "measurement", "mdi:home-percent"},
+  {"on_time_7d", "Shed Light On Time 7d", "on_h_7d", "duration", "h", "measurement", "mdi:lightbulb-on"},
+  {"switches_7d", "Shed Light Switches 7d", "switches_7d", nullptr, nullptr, "measurement", "mdi:counter"},
+  {"motion_rate_7d", "Shed Motion Rate 7d", "motion_per_h_7d", nullptr, "events/h", "measurement", "mdi:motion-sensor"},
+  {"occupancy_7d", "Shed Occupancy 7d", "occupancy_pct_7d", nullptr, "%", "measurement", "mdi:home-percent"},
+  // Relay wear, for maintenance
+  {"relay_cycles", "Shed Relay Cycles", "switches_total", nullptr, nullptr, "total_increasing", "mdi:counter"},
+  {"on_time_total", "Shed Light On Time Total", "on_h_total", "duration", "h", "total_increasing", "mdi:lightbulb-on"},
+};
+
+// Only announced when POWER_BATTERY_CHANNEL is fitted
+constexpr StatsSensorDescriptor BATTERY_SENSORS[] = {
+  {"soc", "Shed Battery Charge", "soc_pct", "battery", "%", "measurement", nullptr},
+  {"remaining", "Shed Battery Remaining", "remaining_ah", nullptr, "Ah", "measurement", "mdi:battery-outline"},
+  {"time_to_empty", "Shed Battery Time To Empty", "tte_h", "duration", "h", "measurement", "mdi:battery-arrow-down"},
+  {"time_to_full", "Shed Battery Time To Full", "ttf_h", "duration", "h", "measurement", "mdi:battery-arrow-up"},
+};
+
+// The energy sensors go out as a second document on their own topic; the
+// shared device ids make Home Assistant attach them to the same device.
+static const char* DISCOVERY_TOPIC = "homeassistant/device/shed_esp32_c6_01/config";
+static const char* ENERGY_DISCOVERY_TOPIC = "homeassistant/device/shed_esp32_c6_01_energy/config";
+
+// --- JSON Writer ---
+// Writes object members straight to the output, tracking only whether a
+// comma is needed.
+class JsonObjectWriter {
+public:
+  explicit JsonObjectWriter(Print& out) : out(out) { out.print('{'); }
+
+  void field(const char* key, const char* value) {
+    if (value == nullptr) return;
+    write_key(key);
+    write_string(value);
+  }
+
+  void field(const char* key, long value) {
+    write_key(key);
+    out.print(value);
+  }
+
+  // Starts a nested object; finish it with close() before the next field.
+  void open(const char* key) {
+    write_key(key);
+    out.print('{');
+    first = true;
+  }
+
+  void close() {
+    out.print('}');
+    first = false;
+  }
+
+private:
+  void write_key(const char* key) {
+    if (!first) out.print(',');
+    first = false;
+    write_string(key);
+    out.print(':');
+  }
+
+  void write_string(const char* value) {
+    out.print('"');
+    for (const char* c = value; *c; c++) {
+      if (*c == '"' || *c == '\\') out.print('\\');
+      out.print(*c);
+    }
+    out.print('"');
+  }
+
+  Print& out;
+  bool first = true;
+};
+
+static void write_availability(JsonObjectWriter& json) {
+  json.field("avty_t", MQTT_TOPIC_AVAILABILITY);
+  json.field("pl_avail", MQTT_PAYLOAD_ONLINE);
+  json.field("pl_not_avail", MQTT_PAYLOAD_OFFLINE);
+}
+
+static void write_origin(JsonObjectWriter& json) {
+  json.open("o");
+  json.field("name", "Shed Monitor (o)");
+  json.field("sw", "0.1");
+  json.field("url", "https://switz.org");
+  json.close();
+}
+
+static void write_entity(JsonObjectWriter& json, const EntityDescriptor& entity) {
+  json.open(entity.key);
+  json.field("name", entity.name);
+  json.field("p", entity.platform);
+  json.field("dev_cla", entity.deviceClass);
+  if (entity.min < entity.max) {
+    json.field("min", (long)entity.min);
+    json.field("max", (long)entity.max);
+  }
+  json.field("unit_of_meas", entity.unit);
+  json.field("uniq_id", entity.uniqueId);
+  json.field("object_id", entity.objectId);
+  if (entity.baseTopic) json.field("~", *entity.baseTopic);
+  if (entity.stateTopic) json.field("stat_t", *entity.stateTopic);
+  if (entity.commandTopic) json.field("cmd_t", *entity.commandTopic);
+  write_availability(json);
+  json.field("pl_on", entity.payloadOn);
+  json.field("pl_off", entity.payloadOff);
+  json.close();
+}
+
+// Power sensors follow POWER_TELEMETRY_MODE; energy sensors are always per
+// channel JSON.
+static void write_value_template(JsonObjectWriter& json, int ch, const ChannelSensorDescriptor& sensor,
+                                 PowerTelemetryMode mode) {
+  char text[64];
+  if (mode == POWER_TELEMETRY_PACKED) {
+    int offset = POWER_PACKED_HEADER_BYTES + (ch - 1) * POWER_PACKED_CHANNEL_BYTES + 4 * sensor.packedField;
+    snprintf(text, sizeof(text), "{{ value | unpack('>f', offset=%d) | round(3) }}", offset);
+    json.field("val_tpl", text);
+    json.field("e", "");  // Hand the template the raw bytes
+  } else if (mode == POWER_TELEMETRY_JSON) {
+    snprintf(text, sizeof(text), "{{ value_json.ch%d.%s }}", ch, sensor.valueField);
+    json.field("val_tpl", text);
+  } else {
+    snprintf(text, sizeof(text), "{{ value_json.%s }}", sensor.valueField);
+    json.field("val_tpl", text);
+  }
+}
+
+static void write_channel_sensor(JsonObjectWriter& json, int ch, const ChannelSensorDescriptor& sensor,
+                                 const char* stateTopic, PowerTelemetryMode mode) {
+  const ChannelDescriptor& channel = CHANNELS[ch - 1];
+  char text[64];
+
+  snprintf(text, sizeof(text), "shed_monitor_power_ch%d_%s", ch, sensor.suffix);
+  json.open(text);
+  snprintf(text, sizeof(text), "%s %s", channel.label, sensor.label);
+  json.field("name", text);
+  json.field("p", "sensor");
+  json.field("dev_cla", sensor.deviceClass);
+  json.field("unit_of_meas", sensor.unit);
+  json.field("stat_cla", sensor.stateClass);
+  write_value_template(json, ch, sensor, mode);
+  snprintf(text, sizeof(text), "shed_esp32_power_ch%d_%s", ch, sensor.suffix);
+  json.field("uniq_id", text);
+  snprintf(text, sizeof(text), "shed_%s_%s", channel.objectName, sensor.suffix);
+  json.field("object_id", text);
+  json.field("ic", sensor.icon ? sensor.icon : channel.icon);
+  json.field("stat_t", stateTopic);
+  write_availability(json);
+  json.close();
+}
+
+static void write_stats_sensor(JsonObjectWriter& json, const StatsSensorDescriptor& sensor, const char* group,
+                               const char* stateTopic) {
+  char text[64];
+
+  snprintf(text, sizeof(text), "shed_monitor_%s_%s", group, sensor.suffix);
+  json.open(text);
+  json.field("name", sensor.name);
+  json.field("p", "sensor");
+  json.field("dev_cla", sensor.deviceClass);
+  json.field("unit_of_meas", sensor.unit);
+  json.field("stat_cla", sensor.stateClass);
+  snprintf(text, sizeof(text), "{{ value_json.%s }}", sensor.valueField);
+  json.field("val_tpl", text);
+  snprintf(text, sizeof(text), "shed_esp32_%s_%s", group, sensor.suffix);
+  json.field("uniq_id", text);
+  snprintf(text, sizeof(text), "shed_%s_%s", group, sensor.suffix);
+  json.field("object_id", text);
+  json.field("ic", sensor.icon);
+  json.field("stat_t", stateTopic);
+  write_availability(json);
+  json.close();
+}
+
+template <size_t N>
+static void write_channel_sensors(JsonObjectWriter& json, const ChannelSensorDescriptor (&sensors)[N], bool energy) {
+  PowerTelemetryMode mode = energy ? POWER_TELEMETRY_PER_CHANNEL : POWER_TELEMETRY_MODE;
+  for (int ch = 1; ch <= 3; ch++) {
+    // Nothing is ever published for a channel that is not fitted
+    if (!power_channel_fitted(ch)) continue;
+    const char* stateTopic = energy ? *CHANNELS[ch - 1].energyTopic : *CHANNELS[ch - 1].powerTopic;
+    if (mode != POWER_TELEMETRY_PER_CHANNEL) stateTopic = MQTT_TOPIC_POWER_STATE;
+    for (const ChannelSensorDescriptor& sensor : sensors) {
+      if (sensor.channels & (1 << (ch - 1))) write_channel_sensor(json, ch, sensor, stateTopic, mode);
+    }
+  }
+}
+
+static void render_main_document(Print& out) {
+  JsonObjectWriter json(out);
+  json.open("device");
+  json.field("name", "Shed Monitor System");
+  json.field("ids", DEVICE_ID);
+  json.field("mf", "Seeed Studio");
+  json.field("mdl", "XIAO ESP32-C6");
+  json.field("suggested_area", "Shed");
+  json.close();
+  write_origin(json);
+
+  json.open("cmps");
+  for (const EntityDescriptor& entity : ENTITIES) write_entity(json, entity);
+  write_channel_sensors(json, POWER_SENSORS, false);
+  for (const StatsSensorDescriptor& sensor : STATS_SENSORS) {
+    write_stats_sensor(json, sensor, "light", MQTT_TOPIC_LIGHT_STATS_STATE);
+  }
+  if (power_channel_fitted(POWER_BATTERY_CHANNEL)) {
+    for (const StatsSensorDescriptor& sensor : BATTERY_SENSORS) {
+      write_stats_sensor(json, sensor, "battery", MQTT_TOPIC_BATTERY_STATE);
+    }
+  }
+  json.close();
+  json.close();
+}
+
+static void render_energy_document(Print& out) {
+  JsonObjectWriter json(out);
+  json.open("device");
+  json.field("name", "Shed Monitor System");
+  json.field("ids", DEVICE_ID);
+  json.close();
+  write_origin(json);
+
+  json.open("cmps");
+  write_channel_sensors(json, ENERGY_SENSORS, true);
+  json.close();
+  json.close();
+}
+
+// --- Publishing ---
+void mqtt_discovery() {
+  if (!PUBLISH_DISCOVERY) {
+    Serial.println("PUBLISH_DISCOVERY is set to false. Skipping MQTT Discovery publish.");
+    Serial.println("--- Discovery Payload ---");
+    render_main_document(Serial);
+    Serial.println();
+    render_energy_document(Serial);
+    Serial.println();
+    return;
+  }
+
+  Serial.print("Publishing MQTT Discovery Payload to ");
+  Serial.println(DISCOVERY_TOPIC);
+  if (!publish_streamed(DISCOVERY_TOPIC, render_main_document, true)) {
+    Serial.println("Discovery publish failed.");
+  }
+  if (!publish_streamed(ENERGY_DISCOVERY_TOPIC, render_energy_document, true)) {
+    Serial.println("Energy discovery publish failed.");
+  }
+}
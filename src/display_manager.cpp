@@ -1,111 +1,324 @@
 #include "display_manager.h"
 #include "config.h"
-#include "utils.h"
+#include "text_format.h"
+#include "loop_profiler.h"
+#include "power_history.h"
 #include <Adafruit_GFX.h>
 #include <Adafruit_SH110X.h>
+#include <Wire.h>
 
 // --- Private Objects ---
 static Adafruit_SH1107 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
+// --- Shadow Frame (dirty-region flushing) ---
+// A copy of the last frame actually sent to the panel. Every flush compares the
+// freshly rendered buffer against it, page by page, and only sends the columns
+// that changed instead of pushing the whole 2 KB frame over the shared I2C bus.
+static uint8_t* shadowFrame = nullptr;
+static bool shadowFrameValid = false;
+
+// SH1107 command bytes used for page-addressed writes
+static const uint8_t SH1107_CONTROL_COMMAND = 0x00;
+static const uint8_t SH1107_CONTROL_DATA = 0x40;
+static const uint8_t SH1107_SET_PAGE_ADDRESS = 0xB0;
+static const uint8_t SH1107_SET_COLUMN_HIGH = 0x10;
+static const uint8_t SH1107_SET_COLUMN_LOW = 0x00;
+
+// Largest data run per I2C transaction (Wire buffer minus the control byte)
+#ifdef I2C_BUFFER_LENGTH
+static const int OLED_I2C_CHUNK = I2C_BUFFER_LENGTH - 1;
+#else
+static const int OLED_I2C_CHUNK = 31;
+#endif
+
+// --- I2C Bandwidth Accounting ---
+static unsigned long displayBytesSent = 0;      // Bytes sent in the current 1 s window
+static unsigned long displayBytesPerSecond = 0; // Result of the last completed window
+static unsigned long bytesWindowStart = 0;
+
+// --- Panel Power ---
+static DisplayPower displayPower = DISPLAY_AWAKE;
+
+
+
+
+// --- Private Flush Functions ---
+
+// Sends one contiguous run of columns within a single page.
+static void send_page_span(uint8_t page, int startColumn, const uint8_t* data, int length) {
+  uint8_t column = startColumn + OLED_COLUMN_OFFSET;
+  Wire.beginTransmission(OLED_I2C_ADDRESS);
+  Wire.write(SH1107_CONTROL_COMMAND);
+  Wire.write(SH1107_SET_PAGE_ADDRESS | page);
+  Wire.write(SH1107_SET_COLUMN_HIGH | (column >> 4));
+  Wire.write(SH1107_SET_COLUMN_LOW | (column & 0x0F));
+  Wire.endTransmission();
+  displayBytesSent += 5; // Address byte + control byte + 3 command bytes
+
+  while (length > 0) {
+    int chunk = min(length, OLED_I2C_CHUNK);
+    Wire.beginTransmission(OLED_I2C_ADDRESS);
+    Wire.write(SH1107_CONTROL_DATA);
+    Wire.write(data, chunk);
+    Wire.endTransmission();
+    displayBytesSent += chunk + 2; // Address byte + control byte + data
+    data += chunk;
+    length -= chunk;
+  }
+}
 
-// --- Forward declarations for new private drawing functions ---
-static void draw_lights_menu_screen(const DisplayData& data);
-static void draw_edit_timer_screen(const DisplayData& data, bool isMotionTimer);
+// Replaces display.display(): transmits only the part of each page that differs
+// from the shadow frame. The first call (or a failed shadow allocation) sends
+// everything.
+static void flush_display() {
+  uint8_t* frame = display.getBuffer();
+  const int pages = SCREEN_HEIGHT / 8;
+
+  for (int page = 0; page < pages; page++) {
+    const uint8_t* row = frame + page * SCREEN_WIDTH;
+    int first = 0;
+    int last = SCREEN_WIDTH - 1;
+
+    if (shadowFrame != nullptr && shadowFrameValid) {
+      const uint8_t* shadowRow = shadowFrame + page * SCREEN_WIDTH;
+      while (first < SCREEN_WIDTH && row[first] == shadowRow[first]) first++;
+      if (first == SCREEN_WIDTH) continue; // Page unchanged, skip it entirely
+      while (row[last] == shadowRow[last]) last--;
+    }
 
+    send_page_span(page, first, row + first, last - first + 1);
+    if (shadowFrame != nullptr) {
+      memcpy(shadowFrame + page * SCREEN_WIDTH + first, row + first, last - first + 1);
+    }
+  }
+  shadowFrameValid = true;
 
-// --- Private Drawing Functions ---
+  unsigned long elapsed = millis() - bytesWindowStart;
+  if (elapsed >= 1000) {
+    displayBytesPerSecond = (displayBytesSent * 1000UL) / elapsed;
+    displayBytesSent = 0;
+    bytesWindowStart = millis();
+  }
+}
 
-static void draw_power_all_screen(const DisplayData& data) {
-  display.clearDisplay();
-  display.setTextColor(SH110X_WHITE);
+
+// --- Text Layout ---
+// The built-in 5x7 font advances 6 px per character at size 1, so centering
+// is plain arithmetic instead of a getTextBounds() pass over every glyph.
+static const int GLYPH_ADVANCE = 6;
+
+static int centered_x(const char* text, int textSize) {
+  return (SCREEN_WIDTH - (int)strlen(text) * GLYPH_ADVANCE * textSize) / 2;
+}
+
+static void print_centered(const char* text, int textSize, int y) {
+  display.setTextSize(textSize);
+  display.setCursor(centered_x(text, textSize), y);
+  display.print(text);
+}
+
+// A reading with its unit, e.g. "12.34 V"
+static void print_reading(float value, uint8_t decimals, const char* unit) {
+  char text[16];
+  TextBuffer(text, sizeof(text)).append_fixed(value, decimals).append(unit);
+  display.print(text);
+}
+
+// Hours and minutes, e.g. "5h 07m", or whole days past 99 hours
+static void print_hours_minutes(uint32_t minutes) {
+  char text[16];
+  TextBuffer out(text, sizeof(text));
+  uint32_t hours = minutes / 60;
+  if (hours > 99) {
+    out.append_unsigned(hours / 24).append('d');
+  } else {
+    out.append_unsigned(hours).append("h ");
+    if (minutes % 60 < 10) out.append('0');
+    out.append_unsigned(minutes % 60).append('m');
+  }
+  display.print(text);
+}
+
+// --- Static Background Layers ---
+// Borders, titles, dividers and labels never change while a screen is showing.
+// They are drawn once into the framebuffer and copied aside; every later frame
+// of the same screen starts from a memcpy of that copy and only draws the
+// dynamic fields on top.
+enum BackgroundLayer {
+  LAYER_NONE,
+  LAYER_POWER_ALL,
+  LAYER_POWER_CH1,
+  LAYER_POWER_CH2,
+  LAYER_POWER_CH3,
+  LAYER_LIGHTS,
+  LAYER_LIGHTS_MENU,
+  LAYER_EDIT_MOTION_TIMER,
+  LAYER_EDIT_MANUAL_TIMER,
+  LAYER_DIAGNOSTICS
+};
+
+static uint8_t* backgroundFrame = nullptr;     // Cached layer, one screen's worth
+static BackgroundLayer cachedLayer = LAYER_NONE;
+
+static const char* const CHANNEL_TITLES[] = {"", "PANEL", "BATTERY", "LOAD"};
+static const char* const POWER_ALL_LABELS[] = {"Solar Panel", "Battery", "Load"};
+
+// Border, centred size-2 title and the divider under it
+static void draw_titled_frame(const char* title) {
   display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
-  
-  display.setTextSize(2);
-  String title = "POWER";
-  int16_t x1, y1;
-  uint16_t w, h;
-  display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
-  display.setCursor((SCREEN_WIDTH - w) / 2, 8);
-  display.println(title);
-  
+  print_centered(title, 2, 8);
   display.drawLine(5, 28, SCREEN_WIDTH - 5, 28, SH110X_WHITE);
-  
-  const char* labels[] = {"Solar Panel", "Battery", "Load"};
-  
+}
+
+static void draw_background(BackgroundLayer layer) {
+  display.setTextColor(SH110X_WHITE);
+  switch (layer) {
+    case LAYER_POWER_ALL:
+      draw_titled_frame("POWER");
+      display.setTextSize(1);
+      for (int i = 0; i < 3; i++) {
+        int yPos = 38 + (i * 30);
+        display.setCursor(8, yPos);
+        display.print(POWER_ALL_LABELS[i]);
+        if (i < 2) display.drawLine(5, yPos + 25, SCREEN_WIDTH - 5, yPos + 25, SH110X_WHITE);
+      }
+      break;
+    case LAYER_POWER_CH1:
+    case LAYER_POWER_CH2:
+    case LAYER_POWER_CH3:
+      draw_titled_frame(CHANNEL_TITLES[layer - LAYER_POWER_CH1 + 1]);
+      display.setTextSize(1);
+      display.setCursor(10, 45);
+      display.print("Voltage:");
+      display.setCursor(10, 65);
+      display.print("Current:");
+      display.setCursor(10, 85);
+      display.print("Power:");
+      if (layer - LAYER_POWER_CH1 + 1 == POWER_BATTERY_CHANNEL) {
+        display.setCursor(10, 105);
+        display.print("Charge:");
+      }
+      break;
+    case LAYER_LIGHTS:
+      display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
+      display.drawRoundRect(10, 40, SCREEN_WIDTH - 20, 8, 2, SH110X_WHITE);
+      display.drawLine(5, 60, SCREEN_WIDTH - 5, 60, SH110X_WHITE);
+      display.setTextSize(1);
+      display.setCursor(10, 70);
+      display.print("Time On");
+      display.setCursor(10, 100);
+      display.print("Time Left");
+      break;
+    case LAYER_LIGHTS_MENU:
+      draw_titled_frame("LIGHTS");
+      break;
+    case LAYER_EDIT_MOTION_TIMER:
+    case LAYER_EDIT_MANUAL_TIMER:
+      draw_titled_frame(layer == LAYER_EDIT_MOTION_TIMER ? "MOTION" : "MANUAL");
+      print_centered("Turn to adjust.", 1, 104);
+      print_centered("Press to save.", 1, 114);
+      break;
+    case LAYER_DIAGNOSTICS:
+      draw_titled_frame("DIAG");
+      display.setTextSize(1);
+      display.setCursor(6, 33);
+      display.print("us");
+      display.setCursor(52, 33);
+      display.print("avg");
+      display.setCursor(82, 33);
+      display.print("p99");
+      display.setCursor(106, 33);
+      display.print("max");
+      for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        display.setCursor(6, 45 + (s * 9));
+        display.print(get_profile_stage_name((ProfileStage)s));
+      }
+      display.setCursor(6, 119);
+      display.print("OLED");
+      break;
+    case LAYER_NONE:
+      break;
+  }
+}
+
+// Starts a frame from the screen's background, rendering and caching it first
+// if another screen was showing. Without the cache buffer every frame simply
+// redraws the background.
+static void begin_frame(BackgroundLayer layer) {
+  uint8_t* frame = display.getBuffer();
+  const size_t frameBytes = (SCREEN_WIDTH * SCREEN_HEIGHT) / 8;
+  if (backgroundFrame != nullptr && cachedLayer == layer) {
+    memcpy(frame, backgroundFrame, frameBytes);
+  } else {
+    display.clearDisplay();
+    draw_background(layer);
+    if (backgroundFrame != nullptr) {
+      memcpy(backgroundFrame, frame, frameBytes);
+      cachedLayer = layer;
+    }
+  }
+  display.setTextColor(SH110X_WHITE);
+}
+
+
+// --- Screen Renderers ---
+// Each draws one whole screen and flushes it; user_interface.cpp decides which
+// one to call and when.
+
+void draw_power_all_screen(const DisplayData& data) {
+  begin_frame(LAYER_POWER_ALL);
   display.setTextSize(1);
   for (int i = 0; i < 3; i++) {
     int yPos = 38 + (i * 30);
-    display.setCursor(8, yPos);
-    display.print(labels[i]);
     display.setCursor(10, yPos + 12);
-    display.print(data.busVoltage[i], 2);
-    display.print("V");
+    print_reading(data.busVoltage[i], 2, "V");
     display.setCursor(70, yPos + 12);
-    display.print(data.current[i], 0);
-    display.print("mA");
-    if (i < 2) {
-        display.drawLine(5, yPos + 25, SCREEN_WIDTH - 5, yPos + 25, SH110X_WHITE);
-    }
+    print_reading(data.current[i], 0, "mA");
   }
 
-  display.display();
+  flush_display();
 }
 
-static void draw_power_ch_live_screen(int channel, const DisplayData& data) {
-    const char* titles[] = {"", "PANEL", "BATTERY", "LOAD"};
-    display.clearDisplay();
-    display.setTextColor(SH110X_WHITE);
-    display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
-    
-    display.setTextSize(2);
-    String title = titles[channel];
-    int16_t x1, y1;
-    uint16_t w, h;
-    display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, 8);
-    display.println(title);
-    
-    display.drawLine(5, 28, SCREEN_WIDTH - 5, 28, SH110X_WHITE);
-
+void draw_power_channel_screen(int channel, const DisplayData& data) {
+    begin_frame((BackgroundLayer)(LAYER_POWER_CH1 + channel - 1));
     display.setTextSize(1);
-    display.setCursor(10, 45);
-    display.print("Voltage:");
     display.setCursor(70, 45);
-    display.print(data.busVoltage[channel-1], 2);
-    display.print(" V");
-
-    display.setCursor(10, 65);
-    display.print("Current:");
+    print_reading(data.busVoltage[channel-1], 2, " V");
     display.setCursor(70, 65);
-    display.print(data.current[channel-1], 0);
-    display.print(" mA");
-    
-    display.setCursor(10, 85);
-    display.print("Power:");
+    print_reading(data.current[channel-1], 0, " mA");
     display.setCursor(70, 85);
-    display.print(data.power[channel-1], 0);
-    display.print(" mW");
-    
-    display.display();
+    print_reading(data.power[channel-1], 0, " mW");
+
+    if (channel == POWER_BATTERY_CHANNEL && data.battery.valid) {
+      display.setCursor(70, 105);
+      print_reading(data.battery.socPermille / 10.0f, 1, " %");
+      // Only one of the two is known at a time, and neither while resting
+      if (data.battery.minutesToEmpty != BATTERY_TIME_UNKNOWN) {
+        display.setCursor(10, 117);
+        display.print("To empty:");
+        display.setCursor(70, 117);
+        print_hours_minutes(data.battery.minutesToEmpty);
+      } else if (data.battery.minutesToFull != BATTERY_TIME_UNKNOWN) {
+        display.setCursor(10, 117);
+        display.print("To full:");
+        display.setCursor(70, 117);
+        print_hours_minutes(data.battery.minutesToFull);
+      }
+    }
+
+    flush_display();
 }
 
-static void draw_lights_live_screen(const DisplayData& data) {
-  display.clearDisplay();
-  display.setTextColor(SH110X_WHITE);
-  display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
-  
-  display.setTextSize(3);
-  String stateText = data.lightIsOn ? "ON" : "OFF";
+void draw_lights_live_screen(const DisplayData& data) {
+  begin_frame(LAYER_LIGHTS);
+
+  const char* stateText = data.lightIsOn ? "ON" : "OFF";
   if (data.lightManualOverride) {
       stateText = "MANUAL";
   }
-  int16_t x1, y1;
-  uint16_t w, h;
-  display.getTextBounds(stateText, 0, 0, &x1, &y1, &w, &h);
-  display.setCursor((SCREEN_WIDTH - w) / 2, 8);
-  display.println(stateText);
-  
-  unsigned long currentTimerDuration = get_current_timer_duration(data.lightManualOverride);
+  print_centered(stateText, 3, 8);
+
+  unsigned long currentTimerDuration = data.currentTimerDuration;
 
   int barWidth = 0;
   if(data.lightIsOn) {
@@ -117,25 +330,14 @@ static void draw_lights_live_screen(const DisplayData& data) {
     barWidth = 0;
   }
   barWidth = (SCREEN_WIDTH - 20) - barWidth;
+  display.fillRoundRect(10, 40, barWidth, 8, 2, SH110X_WHITE);
 
-  int barY = 40;
-  display.drawRoundRect(10, barY, SCREEN_WIDTH - 20, 8, 2, SH110X_WHITE);
-  display.fillRoundRect(10, barY, barWidth, 8, 2, SH110X_WHITE);
-  
-  display.drawLine(5, 60, SCREEN_WIDTH - 5, 60, SH110X_WHITE);
-
-  display.setTextSize(1);
-  display.setCursor(10, 70);
-  display.print("Time On");
-
+  char timeText[DURATION_TEXT_SIZE];
+  format_duration(timeText, data.lightIsOn ? millis() - data.lightOnTime : 0);
   display.setTextSize(2);
   display.setCursor(10, 80);
-  display.print(formatDuration(data.lightIsOn ? millis() - data.lightOnTime : 0));
-  
-  display.setTextSize(1);
-  display.setCursor(10, 100);
-  display.print("Time Left");
-  
+  display.print(timeText);
+
   unsigned long timeRemaining = 0;
   if (data.lightIsOn) {
     unsigned long timeSinceMotion = millis() - data.lastMotionTime;
@@ -143,104 +345,262 @@ static void draw_lights_live_screen(const DisplayData& data) {
       timeRemaining = currentTimerDuration - timeSinceMotion;
     }
   }
-  display.setTextSize(2);
+  format_duration(timeText, timeRemaining);
   display.setCursor(10, 110);
-  display.print(formatDuration(timeRemaining));
+  display.print(timeText);
 
-  display.display();
+  flush_display();
 }
 
-static void draw_lights_menu_screen(const DisplayData& data) {
-    display.clearDisplay();
-    display.setTextColor(SH110X_WHITE);
-    display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
+void draw_lights_menu_screen(const DisplayData& data) {
+    begin_frame(LAYER_LIGHTS_MENU);
 
-    display.setTextSize(2);
-    String title = "LIGHTS";
-    int16_t x1, y1;
-    uint16_t w, h;
-    display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, 8);
-    display.println(title);
-    display.drawLine(5, 28, SCREEN_WIDTH - 5, 28, SH110X_WHITE);
-
-    const char* menuItems[] = {"", "Motion", "Manual", "Back"};
-    // --- UPDATED: Dynamic text now reflects actual light state ---
+    // Double click goes back, so the menu needs no Back entry
+    const char* menuItems[] = {"", "Motion", "Manual"};
     menuItems[0] = (data.lightIsOn) ? "Turn Off" : "Turn On";
 
     display.setTextSize(2);
-    for (int i = 0; i < 4; i++) {
+    for (int i = 0; i < 3; i++) {
         int yPos = 40 + (i * 22);
         if (i == data.lightsMenuSelection) {
             display.fillRect(5, yPos - 2, SCREEN_WIDTH - 10, 20, SH110X_WHITE);
             display.setTextColor(SH110X_BLACK);
             display.setCursor(10, yPos);
-            display.println(menuItems[i]);
+            display.print(menuItems[i]);
             display.setTextColor(SH110X_WHITE);
         } else {
             display.setCursor(10, yPos);
-            display.println(menuItems[i]);
+            display.print(menuItems[i]);
         }
     }
-    display.display();
+    flush_display();
 }
 
-// --- UPDATED: Cosmetic changes for the edit screen ---
-static void draw_edit_timer_screen(const DisplayData& data, bool isMotionTimer) {
-    display.clearDisplay();
-    display.setTextColor(SH110X_WHITE);
-    display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
+void draw_edit_timer_screen(const DisplayData& data, bool isMotionTimer) {
+    begin_frame(isMotionTimer ? LAYER_EDIT_MOTION_TIMER : LAYER_EDIT_MANUAL_TIMER);
 
-    display.setTextSize(2);
-    String title = isMotionTimer ? "MOTION" : "MANUAL"; // Shorter title
-    int16_t x1, y1;
-    uint16_t w, h;
-    display.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, 8);
-    display.println(title);
-    display.drawLine(5, 28, SCREEN_WIDTH - 5, 28, SH110X_WHITE);
-    
-    // Display the timer value being edited with a smaller font
-    display.setTextSize(2); // Smaller font size
-    unsigned long durationToDisplay = isMotionTimer ? data.tempMotionTimerDuration : data.tempManualTimerDuration;
-    String timeText = formatDuration(durationToDisplay);
-    display.getTextBounds(timeText, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, 65); // Repositioned
-    display.println(timeText);
-
-    // Display instructional text
-    display.setTextSize(1);
-    String instruction = "Turn to adjust. Press to Save.";
-    display.getTextBounds(instruction, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, 110);
-    display.println(instruction);
+    char timeText[DURATION_TEXT_SIZE];
+    format_duration(timeText, isMotionTimer ? data.tempMotionTimerDuration : data.tempManualTimerDuration);
+    print_centered(timeText, 2, 65);
 
-    display.display();
+    flush_display();
 }
 
 
-static void draw_lights_sub_screen() {
-    display.clearDisplay();
-    display.setTextColor(SH110X_WHITE);
-    display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
-    display.setTextSize(2);
-    display.setCursor(22, 55);
-    display.println("Lights");
-    display.setCursor(10, 75);
-    display.println("Subscreen");
-    display.display();
+// --- Trend (sparkline) Sub-Screen ---
+// Three page-aligned charts of the 1 s history tier (voltage, current, power).
+// The framebuffer is kept between frames: when a new history slot arrives each
+// chart is shifted left one column in place and only the new column is drawn.
+// A full chart redraw only happens on entry or when the auto-scale changes.
+static const int TREND_PLOT_X = 30;                  // First plot column
+static const int TREND_PLOT_W = 94;                  // Columns, one per 1 s slot
+static const int TREND_FIRST_PAGE = 3;               // Charts start below the header
+static const int TREND_PAGES_PER_CHART = 4;          // 32 px per chart
+static const int TREND_CHART_H = TREND_PAGES_PER_CHART * 8;
+
+static int trendChannel = 0;            // Channel on screen, 0 when not showing
+static uint32_t trendSequence = 0;      // history_sequence() last drawn
+static float trendLow[HISTORY_QUANTITY_COUNT];
+static float trendHigh[HISTORY_QUANTITY_COUNT];
+
+static int trend_chart_top(int quantity) {
+  return (TREND_FIRST_PAGE + quantity * TREND_PAGES_PER_CHART) * 8;
 }
 
-static void draw_power_sub_screen(int channel) {
-    display.clearDisplay();
+// Maps a value to a row inside the chart, leaving a 1 px gap above and below
+static int trend_y(int quantity, float value) {
+  int top = trend_chart_top(quantity) + 1;
+  int bottom = trend_chart_top(quantity) + TREND_CHART_H - 2;
+  float span = trendHigh[quantity] - trendLow[quantity];
+  int y = bottom - (int)lroundf((value - trendLow[quantity]) * (bottom - top) / span);
+  return constrain(y, top, bottom);
+}
+
+// Widens the visible min/max to a round step so small wobbles don't force rescales
+static void trend_nice_range(float low, float high, float minSpan, float& outLow, float& outHigh) {
+  float span = max(high - low, minSpan);
+  float step = powf(10.0f, floorf(log10f(span)));
+  if (span / step < 2.0f) step /= 5.0f;
+  else if (span / step < 5.0f) step /= 2.0f;
+  outLow = floorf(low / step) * step;
+  outHigh = ceilf(high / step) * step;
+  if (outHigh - outLow < minSpan) outHigh = outLow + minSpan;
+}
+
+// Returns true if the auto-scale range changed
+static bool trend_update_scale(int channel, int quantity) {
+  static const float MIN_SPAN[HISTORY_QUANTITY_COUNT] = {0.1f, 10.0f, 100.0f};
+  float low = INFINITY;
+  float high = -INFINITY;
+  int count = min(history_count(HISTORY_1S), TREND_PLOT_W);
+  for (int age = 0; age < count; age++) {
+    HistoryPoint point;
+    history_get(HISTORY_1S, channel, (HistoryQuantity)quantity, age, point);
+    low = min(low, point.min);
+    high = max(high, point.max);
+  }
+  if (count == 0) {
+    low = 0.0f;
+    high = 0.0f;
+  }
+
+  float niceLow, niceHigh;
+  trend_nice_range(low, high, MIN_SPAN[quantity], niceLow, niceHigh);
+  bool changed = (niceLow != trendLow[quantity] || niceHigh != trendHigh[quantity]);
+  trendLow[quantity] = niceLow;
+  trendHigh[quantity] = niceHigh;
+  return changed;
+}
+
+// Prints an axis value in at most 4 characters
+static void print_axis_value(float value) {
+  char text[8];
+  TextBuffer out(text, sizeof(text));
+  float magnitude = fabsf(value);
+  if (magnitude >= 10000.0f) out.append_fixed(value / 1000.0f, 0).append('k');
+  else if (magnitude >= 1000.0f) out.append_fixed(value / 1000.0f, 1).append('k');
+  else if (magnitude >= 100.0f) out.append_fixed(value, 0);
+  else out.append_fixed(value, 1);
+  display.print(text);
+}
+
+// Draws the column for one history slot: the slot's min..max range, joined to
+// the previous slot's mean so the trace stays continuous.
+static void trend_draw_column(int channel, int quantity, int age) {
+  HistoryPoint point;
+  if (!history_get(HISTORY_1S, channel, (HistoryQuantity)quantity, age, point)) return;
+
+  int x = TREND_PLOT_X + TREND_PLOT_W - 1 - age;
+  int yTop = trend_y(quantity, point.max);
+  int yBottom = trend_y(quantity, point.min);
+
+  HistoryPoint previous;
+  if (history_get(HISTORY_1S, channel, (HistoryQuantity)quantity, age + 1, previous)) {
+    int yPrevious = trend_y(quantity, previous.mean);
+    yTop = min(yTop, yPrevious);
+    yBottom = max(yBottom, yPrevious);
+  }
+  display.drawFastVLine(x, yTop, yBottom - yTop + 1, SH110X_WHITE);
+}
+
+static void trend_redraw_chart(int channel, int quantity) {
+  static const char* units[HISTORY_QUANTITY_COUNT] = {"V", "mA", "mW"};
+  int top = trend_chart_top(quantity);
+  display.fillRect(1, top, SCREEN_WIDTH - 2, TREND_CHART_H, SH110X_BLACK);
+
+  display.setTextSize(1);
+  display.setTextColor(SH110X_WHITE);
+  display.setCursor(4, top + 1);
+  print_axis_value(trendHigh[quantity]);
+  display.setCursor(4, top + 12);
+  display.print(units[quantity]);
+  display.setCursor(4, top + TREND_CHART_H - 9);
+  print_axis_value(trendLow[quantity]);
+  display.drawFastVLine(TREND_PLOT_X - 2, top + 1, TREND_CHART_H - 2, SH110X_WHITE);
+
+  int count = min(history_count(HISTORY_1S), TREND_PLOT_W);
+  for (int age = 0; age < count; age++) {
+    trend_draw_column(channel, quantity, age);
+  }
+}
+
+// Moves a chart's plot area one column left, straight in the page-ordered buffer
+static void trend_shift_chart(int quantity) {
+  uint8_t* frame = display.getBuffer();
+  int firstPage = TREND_FIRST_PAGE + quantity * TREND_PAGES_PER_CHART;
+  for (int page = firstPage; page < firstPage + TREND_PAGES_PER_CHART; page++) {
+    uint8_t* row = frame + page * SCREEN_WIDTH + TREND_PLOT_X;
+    memmove(row, row + 1, TREND_PLOT_W - 1);
+    row[TREND_PLOT_W - 1] = 0;
+  }
+}
+
+void draw_power_trend_screen(int channel, const DisplayData& data) {
+    bool fullRedraw = (trendChannel != channel);
+
+    if (fullRedraw) {
+        display.clearDisplay();
+        display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
+        trendChannel = channel;
+        trendSequence = history_sequence(HISTORY_1S);
+        for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+            trend_update_scale(channel, q);
+            trend_redraw_chart(channel, q);
+        }
+    }
+
+    // Header: title and live readings, refreshed every frame
+    display.fillRect(8, 2, SCREEN_WIDTH - 16, 20, SH110X_BLACK);
     display.setTextColor(SH110X_WHITE);
-    display.drawRoundRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 8, SH110X_WHITE);
-    display.setTextSize(2);
-    display.setCursor(10, 55);
-    display.print("CH ");
-    display.print(channel);
-    display.print(" Sub");
-    display.display();
+    display.setTextSize(1);
+    display.setCursor(10, 4);
+    display.print(CHANNEL_TITLES[channel]);
+    display.print(" TREND");
+    display.setCursor(10, 14);
+    print_reading(data.busVoltage[channel - 1], 2, "V ");
+    print_reading(data.current[channel - 1], 0, "mA");
+
+    // Charts: only touch them when the history has moved on
+    uint32_t sequence = history_sequence(HISTORY_1S);
+    uint32_t newSlots = sequence - trendSequence;
+    if (!fullRedraw && newSlots > 0) {
+        for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+            if (trend_update_scale(channel, q) || newSlots >= (uint32_t)TREND_PLOT_W) {
+                trend_redraw_chart(channel, q);
+                continue;
+            }
+            for (uint32_t i = 0; i < newSlots; i++) {
+                trend_shift_chart(q);
+            }
+            for (int age = newSlots - 1; age >= 0; age--) {
+                trend_draw_column(channel, q, age);
+            }
+        }
+    }
+    trendSequence = sequence;
+
+    flush_display();
+}
+
+
+// Prints a microsecond value in at most 5 characters, switching to ms or s when large
+static void print_compact_us(uint32_t us) {
+  char text[8];
+  TextBuffer out(text, sizeof(text));
+  if (us < 100000UL) out.append_unsigned(us);
+  else if (us < 10000000UL) out.append_unsigned(us / 1000).append('m');
+  else out.append_unsigned(us / 1000000).append('s');
+  display.print(text);
+}
+
+void draw_diagnostics_screen() {
+    // Last good copy of each stage, kept while its writer is mid-update
+    static ProfileStats shownStats[PROFILE_STAGE_COUNT];
+    begin_frame(LAYER_DIAGNOSTICS);
+    display.setTextSize(1);
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        ProfileStats& stats = shownStats[s];
+        get_profile_stats((ProfileStage)s, stats);
+        int yPos = 45 + (s * 9);
+        if (stats.count == 0) {
+            // No samples in the window, e.g. no motion or the panel asleep
+            display.setCursor(52, yPos);
+            display.print('-');
+            continue;
+        }
+        display.setCursor(52, yPos);
+        print_compact_us(stats.avgUs);
+        display.setCursor(82, yPos);
+        print_compact_us(stats.p99Us);
+        display.setCursor(106, yPos);
+        print_compact_us(stats.maxUs);
+    }
+
+    display.setCursor(36, 119);
+    display.print(get_display_bytes_per_second());
+    display.print(" B/s");
+
+    flush_display();
 }
 
 
@@ -251,56 +611,45 @@ void setup_display() {
     Serial.println(F("SH1107 allocation failed"));
     for (;;);
   }
+  shadowFrame = (uint8_t*)malloc((SCREEN_WIDTH * SCREEN_HEIGHT) / 8);
+  if (shadowFrame == nullptr) {
+    Serial.println(F("Shadow frame allocation failed, sending full frames"));
+  }
+  shadowFrameValid = false;
+  backgroundFrame = (uint8_t*)malloc((SCREEN_WIDTH * SCREEN_HEIGHT) / 8);
+  if (backgroundFrame == nullptr) {
+    Serial.println(F("Background layer allocation failed, redrawing it every frame"));
+  }
+  bytesWindowStart = millis();
+
+  display.setContrast(OLED_CONTRAST);
   display.clearDisplay();
-  display.display();
+  flush_display();
 }
 
-
-void update_display(DisplayMode mode, LightsSubMode lightsSub, PowerSubMode powerSub, const DisplayData& data) {
-  switch (mode) {
-    case LIGHTS_MODE:
-      switch (lightsSub) {
-        case LIVE_STATUS:
-          draw_lights_live_screen(data);
-          break;
-        case LIGHTS_MENU:
-          draw_lights_menu_screen(data);
-          break;
-        case EDIT_MOTION_TIMER:
-          draw_edit_timer_screen(data, true);
-          break;
-        case EDIT_MANUAL_TIMER:
-          draw_edit_timer_screen(data, false);
-          break;
-      }
-      break;
-    case POWER_MODE_ALL:
-      draw_power_all_screen(data);
-      break;
-    case POWER_MODE_CH1:
-      if (powerSub == LIVE_POWER) {
-        draw_power_ch_live_screen(1, data);
-      } else {
-        draw_power_sub_screen(1);
-      }
-      break;
-    case POWER_MODE_CH2:
-      if (powerSub == LIVE_POWER) {
-        draw_power_ch_live_screen(2, data);
-      } else {
-        draw_power_sub_screen(2);
-      }
+void set_display_power(DisplayPower power) {
+  if (power == displayPower) return;
+  if (displayPower == DISPLAY_ASLEEP) display.oled_command(SH110X_DISPLAYON);
+  switch (power) {
+    case DISPLAY_AWAKE:
+      display.setContrast(OLED_CONTRAST);
       break;
-    case POWER_MODE_CH3:
-      if (powerSub == LIVE_POWER) {
-        draw_power_ch_live_screen(3, data);
-      } else {
-        draw_power_sub_screen(3);
-      }
+    case DISPLAY_DIMMED:
+      display.setContrast(OLED_DIM_CONTRAST);
       break;
-    default:
-      draw_power_all_screen(data);
+    case DISPLAY_ASLEEP:
+      display.oled_command(SH110X_DISPLAYOFF);
       break;
   }
+  displayPower = power;
 }
 
+unsigned long get_display_bytes_per_second() {
+  return displayBytesPerSecond;
+}
+
+
+void display_screen_changed() {
+  // Any other screen overwrites the framebuffer, so the trend view must start over
+  trendChannel = 0;
+}
@@ -1,33 +1,127 @@
 #include "config.h"
 #include <Arduino.h>
+#include "encoder.h"
+#include "spsc_queue.h"
+#include "power_manager.h"
+#ifndef NATIVE_BUILD
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+#endif
 
-// --- Rotary Encoder State Variables ---
-// Using the stable counter-based ISR logic
-volatile int encoderCounter = 0;
-volatile int lastKnownPosition = HIGH;
+// --- Quadrature Decoder ---
+// Both encoder pins interrupt on every edge. The ISR looks up the move from
+// the previous and current 2-bit state (CLK << 1 | DT) in a full-state table:
+// +1 / -1 for a valid quarter step, 0 for no change or an impossible jump
+// (both pins changed, i.e. a bounce). A detent is counted when the encoder
+// settles back in its rest state (both pins high) at least half a cycle away
+// from where it left it, so a missed quarter step does not lose the detent.
+static const int8_t QUADRATURE_TABLE[16] = {
+  //        to: 00  01  10  11
+  /* 00 */       0, -1, +1,  0,
+  /* 01 */      +1,  0,  0, -1,
+  /* 10 */      -1,  0,  0, +1,
+  /* 11 */       0, +1, -1,  0,
+};
+static const uint8_t ENCODER_REST_STATE = 0b11;
 
-// --- Button State Variables ---
-int buttonState;
-int lastButtonState = HIGH;
-unsigned long lastDebounceTime = 0;
-bool buttonClicked = false;
+// --- Velocity Acceleration ---
+// Detents closer together than an entry's interval are worth its multiplier.
+struct EncoderAcceleration {
+  uint32_t maxIntervalUs;
+  int multiplier;
+};
 
-// --- Interrupt Service Routine (ISR) ---
-// This is the stable ISR you provided. It increments/decrements a persistent counter.
-void IRAM_ATTR handleEncoderRotation() {
-  int newClockState = digitalRead(ENCODER_CLK_PIN);
-  if (newClockState != lastKnownPosition) {
-    // A transition has occurred
-    if (newClockState == LOW) {
-      // We act on the falling edge
-      if (digitalRead(ENCODER_DT_PIN) == LOW) {
-        encoderCounter--; // Direction 1
-      } else {
-        encoderCounter++; // Direction 2
-      }
-    }
-    lastKnownPosition = newClockState;
+static const EncoderAcceleration ENCODER_ACCELERATION[] = {
+  {15000, 10},
+  {30000, 5},
+  {60000, 2},
+};
+
+// --- Rotary Encoder State Variables (written by the ISR) ---
+static volatile uint8_t encoderState = ENCODER_REST_STATE;
+static volatile int8_t quarterSteps = 0;
+static volatile int encoderCounter = 0;             // One per detent
+static volatile int acceleratedCounter = 0;         // Detents times the spin multiplier
+static volatile uint32_t lastDetentTime = 0;
+static volatile int lastDetentDirection = 0;
+
+// --- Button Edges ---
+// The button ISR only timestamps edges; debouncing and gesture detection run
+// in loop_encoder() on those timestamps.
+struct ButtonEdge {
+  uint8_t level;
+  unsigned long time;
+};
+
+static SpscQueue<ButtonEdge, 16> buttonEdges;  // ISR -> UI task
+// Set when an edge was dropped; loop_encoder() then re-reads the pin
+static volatile bool buttonEdgesOverflowed = false;
+static SpscQueue<ButtonEvent, 8> buttonEvents;  // Filled and drained by the UI task
+
+// --- Button State Machine (UI task) ---
+enum ButtonPhase {
+  BUTTON_IDLE,
+  BUTTON_PRESSED,      // Down, not yet long enough for a long press
+  BUTTON_HELD,         // Long press sent, repeating
+  BUTTON_WAIT_SECOND   // Released after one click, waiting for a second
+};
+
+static ButtonPhase buttonPhase = BUTTON_IDLE;
+static int stableLevel = HIGH;          // Debounced level
+static int latestLevel = HIGH;          // Level after the most recent edge
+static unsigned long burstStart = 0;    // First edge of the current bounce burst
+static unsigned long lastEdgeTime = 0;
+static unsigned long pressTime = 0;
+static unsigned long releaseTime = 0;
+static unsigned long clickTime = 0;     // Press time of a click waiting for a second one
+static unsigned long nextRepeatTime = 0;
+static bool secondPress = false;        // The current press follows a click
+
+// Both pins in one read, so the ISR never sees a half-updated state
+static inline uint8_t IRAM_ATTR read_encoder_state() {
+#ifdef NATIVE_BUILD
+  return (digitalRead(ENCODER_CLK_PIN) << 1) | digitalRead(ENCODER_DT_PIN);
+#else
+  uint32_t levels = REG_READ(GPIO_IN_REG);
+  return (((levels >> ENCODER_CLK_PIN) & 1) << 1) | ((levels >> ENCODER_DT_PIN) & 1);
+#endif
+}
+
+static int IRAM_ATTR spin_multiplier(int direction, uint32_t now) {
+  uint32_t interval = now - lastDetentTime;
+  lastDetentTime = now;
+  if (direction != lastDetentDirection) {
+    lastDetentDirection = direction;
+    return 1;  // A change of direction is always a fine adjustment
+  }
+  for (const EncoderAcceleration& step : ENCODER_ACCELERATION) {
+    if (interval < step.maxIntervalUs) return step.multiplier;
   }
+  return 1;
+}
+
+// --- Interrupt Service Routine (ISR) ---
+static void IRAM_ATTR handle_encoder_edge() {
+  uint8_t state = read_encoder_state();
+  rearm_wake_interrupt(ENCODER_CLK_PIN, state >> 1);
+  rearm_wake_interrupt(ENCODER_DT_PIN, state & 1);
+  int8_t move = QUADRATURE_TABLE[(encoderState << 2) | state];
+  encoderState = state;
+  quarterSteps += move;
+
+  if (state != ENCODER_REST_STATE) return;
+  int direction = (quarterSteps >= 2) ? 1 : (quarterSteps <= -2) ? -1 : 0;
+  quarterSteps = 0;
+  if (direction == 0) return;
+
+  encoderCounter += direction;
+  acceleratedCounter += direction * spin_multiplier(direction, micros());
+}
+
+static void IRAM_ATTR handle_button_edge() {
+  ButtonEdge edge = {(uint8_t)digitalRead(ENCODER_SW_PIN), millis()};
+  rearm_wake_interrupt(ENCODER_SW_PIN, edge.level);
+  if (!buttonEdges.push(edge)) buttonEdgesOverflowed = true;
 }
 
 void setup_encoder() {
@@ -35,37 +129,96 @@ void setup_encoder() {
   pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
   pinMode(ENCODER_SW_PIN, INPUT_PULLUP);
   
-  // Initialize last known position for the ISR
-  lastKnownPosition = digitalRead(ENCODER_CLK_PIN);
-  // Attach the interrupt to trigger on any state change
-  attachInterrupt(digitalPinToInterrupt(ENCODER_CLK_PIN), handleEncoderRotation, CHANGE);
+  // Start the decoder from wherever the shaft is resting
+  encoderState = read_encoder_state();
+  // Wake sources as well, so a turn or press wakes the chip from light sleep
+  attach_wake_interrupt(ENCODER_CLK_PIN, handle_encoder_edge);
+  attach_wake_interrupt(ENCODER_DT_PIN, handle_encoder_edge);
+
+  stableLevel = latestLevel = digitalRead(ENCODER_SW_PIN);
+  attach_wake_interrupt(ENCODER_SW_PIN, handle_button_edge);
+}
+static void emit_button_event(ButtonEventType type, unsigned long time) {
+  ButtonEvent event = {type, time};
+  buttonEvents.push(event);
+}
+
+static void on_button_pressed(unsigned long time) {
+  // The window is checked here too: in the saving power modes the UI task can
+  // poll late enough that the timeout below has not run yet
+  if (buttonPhase == BUTTON_WAIT_SECOND && time - releaseTime >= BUTTON_DOUBLE_CLICK_MS) {
+    emit_button_event(BUTTON_CLICK, clickTime);
+    buttonPhase = BUTTON_IDLE;
+  }
+  secondPress = (buttonPhase == BUTTON_WAIT_SECOND);
+  buttonPhase = BUTTON_PRESSED;
+  pressTime = time;
+}
 
-  // Initialize button state
-  lastButtonState = digitalRead(ENCODER_SW_PIN);
+static void on_button_released(unsigned long time) {
+  if (buttonPhase == BUTTON_PRESSED) {
+    if (secondPress) {
+      emit_button_event(BUTTON_DOUBLE_CLICK, clickTime);
+      buttonPhase = BUTTON_IDLE;
+    } else {
+      buttonPhase = BUTTON_WAIT_SECOND;
+      releaseTime = time;
+      clickTime = pressTime;
+    }
+  } else {
+    buttonPhase = BUTTON_IDLE;  // End of a long press
+  }
+}
+
+static void record_edge(int level, unsigned long time) {
+  if (time - lastEdgeTime >= BUTTON_DEBOUNCE_MS) burstStart = time;
+  latestLevel = level;
+  lastEdgeTime = time;
 }
 
 void loop_encoder() {
-    // Read the current state of the switch
-    int reading = digitalRead(ENCODER_SW_PIN);
+  // Debounce on the edge timestamps: a new level counts once no edge has
+  // followed it for BUTTON_DEBOUNCE_MS, and is dated from the first edge of
+  // its burst. A spike that returns to the old level is ignored.
+  ButtonEdge edge;
+  while (buttonEdges.pop(edge)) record_edge(edge.level, edge.time);
+  unsigned long now = millis();
+  if (buttonEdgesOverflowed) {
+    buttonEdgesOverflowed = false;
+    record_edge(digitalRead(ENCODER_SW_PIN), now);
+  }
 
-    // If the switch changed, due to noise or pressing
-    if (reading != lastButtonState) {
-        lastDebounceTime = millis();
-    }
+  if (latestLevel != stableLevel && now - lastEdgeTime >= BUTTON_DEBOUNCE_MS) {
+    stableLevel = latestLevel;
+    if (stableLevel == LOW) on_button_pressed(burstStart);
+    else on_button_released(burstStart);
+  }
 
-    if ((millis() - lastDebounceTime) > 50) {
-        // Whatever the reading is at, it's been there for a while
-        // so we assume that it's the stable state
-        if (reading != buttonState) {
-            buttonState = reading;
-
-            // If the button state has changed to LOW (pressed)
-            if (buttonState == LOW) {
-                buttonClicked = true;
-            }
-        }
-    }
-    lastButtonState = reading;
+  switch (buttonPhase) {
+    case BUTTON_PRESSED:
+      if (now - pressTime >= BUTTON_LONG_PRESS_MS) {
+        // A click followed by a long press is a click, then a long press
+        if (secondPress) emit_button_event(BUTTON_CLICK, clickTime);
+        emit_button_event(BUTTON_LONG_PRESS, pressTime);
+        buttonPhase = BUTTON_HELD;
+        nextRepeatTime = now + BUTTON_REPEAT_MS;
+      }
+      break;
+    case BUTTON_HELD:
+      if ((long)(now - nextRepeatTime) >= 0) {
+        emit_button_event(BUTTON_HOLD_REPEAT, now);
+        nextRepeatTime += BUTTON_REPEAT_MS;
+      }
+      break;
+    case BUTTON_WAIT_SECOND:
+      if (now - releaseTime >= BUTTON_DOUBLE_CLICK_MS) {
+        emit_button_event(BUTTON_CLICK, clickTime);
+        buttonPhase = BUTTON_IDLE;
+      }
+      break;
+    case BUTTON_IDLE:
+      break;
+  }
 }
 
 int get_encoder_value() {
@@ -76,11 +229,16 @@ int get_encoder_value() {
   return value;
 }
 
-bool button_was_clicked() {
-    if (buttonClicked) {
-        buttonClicked = false;
-        return true;
-    }
-    return false;
+EncoderPosition get_encoder_position() {
+  EncoderPosition position;
+  noInterrupts();
+  position.value = encoderCounter;
+  position.accelerated = acceleratedCounter;
+  interrupts();
+  return position;
+}
+
+bool get_button_event(ButtonEvent& event) {
+  return buttonEvents.pop(event);
 }
 
@@ -0,0 +1,244 @@
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include <time.h>
+#include "energy_counter.h"
+#include "power_monitor.h"
+#include "connections.h"
+#include "snapshot.h"
+#include "text_format.h"
+#include "config.h"
+
+// --- Fixed-Point Accumulators ---
+// Trapezoids are summed without the final halving, so every counter is in
+// units of 2 mW*ms (energy) or 2 mA*ms (charge). An int64 holds ~145 GWh.
+static const int64_t HALF_UNITS_PER_WH = 2LL * 3600 * 1000 * 1000;
+static const int64_t HALF_UNITS_PER_AH = 2LL * 3600 * 1000 * 1000;
+
+struct EnergyTotals {
+  int64_t energyIn;
+  int64_t energyOut;
+  int64_t chargeIn;
+  int64_t chargeOut;
+};
+
+// Saved to NVS as one blob; bump the version when the layout changes
+struct EnergyStore {
+  uint32_t version;
+  int32_t dayId;    // Local days since 1970-01-01, 0 when time was unknown
+  int32_t weekId;   // Weeks since the Monday before the epoch
+  EnergyTotals totals[3][ENERGY_PERIOD_COUNT];
+};
+
+static const uint32_t ENERGY_STORE_VERSION = 1;
+static EnergyStore store;       // Sensor task only
+static Preferences energyPrefs;
+
+// The counters as every other task sees them, republished after each change
+struct EnergySnapshot {
+  EnergyTotals totals[3][ENERGY_PERIOD_COUNT];
+};
+static Snapshot<EnergySnapshot> totalsSnapshot;
+
+// --- Integration State ---
+static int32_t lastPower[3];    // Signed mW of the previous sample
+static int32_t lastCurrent[3];  // mA of the previous sample
+static unsigned long lastSampleTime = 0;
+static bool haveLastSample = false;
+
+static unsigned long lastEnergyPublishTime = 0;  // Network task
+static unsigned long lastEnergySaveTime = 0;
+
+// Days since 1970-01-01 for a civil date (Howard Hinnant's algorithm)
+static int32_t days_from_civil(int year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned yoe = (unsigned)(year - era * 400);
+  const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+// Returns false until SNTP has set the clock
+static bool current_local_day(int32_t& dayId) {
+  time_t now = time(nullptr);
+  if (now < 1700000000) return false;
+  struct tm local;
+  localtime_r(&now, &local);
+  dayId = days_from_civil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+  return true;
+}
+
+static int32_t week_of_day(int32_t dayId) {
+  // 1970-01-01 was a Thursday; shift so weeks start on Monday
+  return (dayId + 3) / 7;
+}
+
+static void save_energy() {
+  energyPrefs.putBytes("store", &store, sizeof(store));
+  lastEnergySaveTime = millis();
+}
+
+static void publish_totals() {
+  EnergySnapshot snapshot;
+  memcpy(snapshot.totals, store.totals, sizeof(snapshot.totals));
+  totalsSnapshot.publish(snapshot);
+}
+
+static float energy_wh(const EnergyTotals& totals, bool discharge) {
+  return (float)((double)(discharge ? totals.energyOut : totals.energyIn) / HALF_UNITS_PER_WH);
+}
+
+static float charge_ah(const EnergyTotals& totals, bool discharge) {
+  return (float)((double)(discharge ? totals.chargeOut : totals.chargeIn) / HALF_UNITS_PER_AH);
+}
+
+static void add_sample(EnergyTotals& totals, int64_t energy, int64_t charge) {
+  if (energy >= 0) totals.energyIn += energy;
+  else totals.energyOut -= energy;
+  if (charge >= 0) totals.chargeIn += charge;
+  else totals.chargeOut -= charge;
+}
+
+static const uint8_t ENERGY_DECIMALS = 3;  // 1 mWh
+static const uint8_t CHARGE_DECIMALS = 4;  // 0.1 mAh
+
+// Writes a counter straight from its integer accumulator. Going through a
+// float would leave only 24 bits of mantissa, so a lifetime counter of a few
+// thousand Wh would already have lost its milli-units.
+static void append_counter(TextBuffer& payload, int64_t halfUnits, int64_t halfUnitsPerUnit, uint8_t decimals) {
+  int64_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+  int64_t halfUnitsPerStep = halfUnitsPerUnit / scale;
+  uint64_t steps = (uint64_t)((halfUnits + halfUnitsPerStep / 2) / halfUnitsPerStep);
+  uint32_t fraction = (uint32_t)(steps % scale);
+  payload.append_unsigned((uint32_t)(steps / scale)).append('.');
+  for (int64_t digit = scale / 10; digit > 1 && fraction < digit; digit /= 10) payload.append('0');
+  payload.append_unsigned(fraction);
+}
+
+static void publish_energy() {
+  const char* topics[3] = {MQTT_TOPIC_ENERGY_CH1_STATE, MQTT_TOPIC_ENERGY_CH2_STATE, MQTT_TOPIC_ENERGY_CH3_STATE};
+  const char* periodKeys[ENERGY_PERIOD_COUNT] = {"day", "week", "total"};
+  EnergySnapshot snapshot = totalsSnapshot.read();
+
+  for (int ch = 1; ch <= 3; ch++) {
+    if (!power_channel_fitted(ch)) continue;
+    char buffer[384];
+    TextBuffer payload(buffer, sizeof(buffer));
+    char separator = '{';
+    for (int p = 0; p < ENERGY_PERIOD_COUNT; p++) {
+      const EnergyTotals& totals = snapshot.totals[ch - 1][p];
+      payload.append(separator).append("\"wh_").append(periodKeys[p]).append("\":");
+      append_counter(payload, totals.energyIn, HALF_UNITS_PER_WH, ENERGY_DECIMALS);
+      payload.append(",\"ah_").append(periodKeys[p]).append("\":");
+      append_counter(payload, totals.chargeIn, HALF_UNITS_PER_AH, CHARGE_DECIMALS);
+      payload.append(",\"wh_out_").append(periodKeys[p]).append("\":");
+      append_counter(payload, totals.energyOut, HALF_UNITS_PER_WH, ENERGY_DECIMALS);
+      payload.append(",\"ah_out_").append(periodKeys[p]).append("\":");
+      append_counter(payload, totals.chargeOut, HALF_UNITS_PER_AH, CHARGE_DECIMALS);
+      separator = ',';
+    }
+    payload.append('}');
+    client.publish(topics[ch - 1], buffer, true);
+  }
+}
+
+// Zeroes the day/week counters when the local date moves on. Counters restored
+// from NVS stay valid if they were saved in the same day/week.
+static void check_period_rollover() {
+  int32_t today;
+  if (!current_local_day(today)) return;
+
+  bool changed = false;
+  if (store.dayId != today) {
+    if (store.dayId != 0) {
+      for (int ch = 0; ch < 3; ch++) memset(&store.totals[ch][ENERGY_DAY], 0, sizeof(EnergyTotals));
+    }
+    store.dayId = today;
+    changed = true;
+  }
+  int32_t week = week_of_day(today);
+  if (store.weekId != week) {
+    if (store.weekId != 0) {
+      for (int ch = 0; ch < 3; ch++) memset(&store.totals[ch][ENERGY_WEEK], 0, sizeof(EnergyTotals));
+    }
+    store.weekId = week;
+    changed = true;
+  }
+  if (changed) {
+    save_energy();
+    publish_totals();
+  }
+}
+
+void setup_energy() {
+  energyPrefs.begin("energy", false);
+  size_t length = energyPrefs.getBytesLength("store");
+  if (length == sizeof(store) && energyPrefs.getBytes("store", &store, sizeof(store)) == sizeof(store) &&
+      store.version == ENERGY_STORE_VERSION) {
+    Serial.println("Energy counters restored from NVS.");
+  } else {
+    memset(&store, 0, sizeof(store));
+    store.version = ENERGY_STORE_VERSION;
+    Serial.println("Energy counters initialised.");
+  }
+  lastEnergySaveTime = millis();
+  lastEnergyPublishTime = millis();
+  publish_totals();
+}
+
+void energy_record_sample(const float power[3], const float current[3]) {
+  unsigned long now = millis();
+  int32_t powerNow[3];
+  int32_t currentNow[3];
+  for (int ch = 0; ch < 3; ch++) {
+    // The INA226 power register has no sign, so borrow it from the current
+    int32_t magnitude = lroundf(fabsf(power[ch]));
+    currentNow[ch] = lroundf(current[ch]);
+    powerNow[ch] = (currentNow[ch] < 0) ? -magnitude : magnitude;
+  }
+
+  if (haveLastSample) {
+    // Unsigned subtraction keeps dt correct across the millis() wraparound
+    int64_t dt = (int64_t)(unsigned long)(now - lastSampleTime);
+    for (int ch = 0; ch < 3; ch++) {
+      int64_t energy = ((int64_t)lastPower[ch] + powerNow[ch]) * dt;
+      int64_t charge = ((int64_t)lastCurrent[ch] + currentNow[ch]) * dt;
+      for (int p = 0; p < ENERGY_PERIOD_COUNT; p++) {
+        add_sample(store.totals[ch][p], energy, charge);
+      }
+    }
+  }
+
+  memcpy(lastPower, powerNow, sizeof(lastPower));
+  memcpy(lastCurrent, currentNow, sizeof(lastCurrent));
+  lastSampleTime = now;
+  haveLastSample = true;
+  publish_totals();
+}
+
+void loop_energy() {
+  check_period_rollover();
+
+  if (millis() - lastEnergySaveTime >= ENERGY_SAVE_INTERVAL) {
+    save_energy();
+  }
+}
+
+void loop_energy_publisher() {
+  if (millis() - lastEnergyPublishTime >= ENERGY_PUBLISH_INTERVAL) {
+    lastEnergyPublishTime = millis();
+    publish_energy();
+  }
+}
+
+float get_energy_wh(int channel, EnergyPeriod period, bool discharge) {
+  if (channel < 1 || channel > 3) return 0.0;
+  return energy_wh(totalsSnapshot.read().totals[channel - 1][period], discharge);
+}
+
+float get_charge_ah(int channel, EnergyPeriod period, bool discharge) {
+  if (channel < 1 || channel > 3) return 0.0;
+  return charge_ah(totalsSnapshot.read().totals[channel - 1][period], discharge);
+}
@@ -0,0 +1,278 @@
+#include <Arduino.h>
+#include <atomic>
+#include <PubSubClient.h>
+#include "light_control.h"
+#include "connections.h"
+#include "spsc_queue.h"
+#include "snapshot.h"
+#include "utils.h"
+#include "text_format.h"
+#include "settings.h"
+#include "light_stats.h"
+#include "loop_profiler.h"
+#include "power_manager.h"
+#include "config.h"
+
+// --- Control State (control task only) ---
+static bool lightIsOn = false;
+static bool lightManualOverride = false;
+static unsigned long lastMotionTime = 0;
+static unsigned long lightOnTime = 0;
+static int pirState = LOW;
+
+// --- Queues Between Tasks ---
+// One SPSC queue per producer keeps every queue single-producer.
+enum LightEventType {
+  LIGHT_EVENT_MOTION,         // value = PIR level
+  LIGHT_EVENT_RELAY,          // value = relay on/off
+  LIGHT_EVENT_MOTION_TIMER,   // value = duration in ms
+  LIGHT_EVENT_MANUAL_TIMER    // value = duration in ms
+};
+
+struct LightEvent {
+  LightEventType type;
+  unsigned long value;
+  bool fromUi;  // Timer changed on the device rather than over MQTT
+};
+
+// --- PIR Edges ---
+// The PIR interrupt timestamps every edge and queues it for the control task,
+// so motion is seen within one control period whatever the other tasks are
+// doing, and the edge-to-relay time can be measured (PROFILE_MOTION). It is
+// also a light-sleep wake source (see power_manager.h).
+struct PirEdge {
+  uint8_t level;
+  uint32_t startUs;  // profile_start() at the edge
+};
+
+static SpscQueue<PirEdge, 16> pirEdges;  // ISR -> control task
+// Set when an edge was dropped; the control task then re-reads the pin
+static volatile bool pirEdgesOverflowed = false;
+
+static void IRAM_ATTR handle_pir_edge() {
+  PirEdge edge = {(uint8_t)digitalRead(PIR_PIN), profile_start()};
+  rearm_wake_interrupt(PIR_PIN, edge.level);
+  if (!pirEdges.push(edge)) pirEdgesOverflowed = true;
+}
+
+static SpscQueue<LightCommand, 8> uiCommands;
+static SpscQueue<LightCommand, 8> networkCommands;
+static SpscQueue<LightEvent, 16> events;
+// Set when an event was dropped; the publisher then resends the full state
+static std::atomic<bool> eventsOverflowed{false};
+
+static Snapshot<LightState> lightState;
+
+static void emit(LightEventType type, unsigned long value, bool fromUi = false) {
+  LightEvent event = {type, value, fromUi};
+  if (!events.push(event)) eventsOverflowed.store(true, std::memory_order_relaxed);
+}
+
+static void apply_command(const LightCommand& command, bool fromUi) {
+  switch (command.type) {
+    case LIGHT_CMD_ON:
+      lightManualOverride = true;
+      lastMotionTime = millis();
+      Serial.println("Manual override ON");
+      break;
+    case LIGHT_CMD_OFF:
+      lightManualOverride = false;
+      lastMotionTime = millis() - get_current_timer_duration(true) - 1;
+      Serial.println("Manual override OFF");
+      break;
+    case LIGHT_CMD_SET_MOTION_TIMER:
+      set_setting(SETTING_MOTION_TIMER, command.value);
+      Serial.print("Motion timer updated to ");
+      Serial.print(command.value / 1000);
+      Serial.println(" seconds.");
+      emit(LIGHT_EVENT_MOTION_TIMER, command.value, fromUi);
+      break;
+    case LIGHT_CMD_SET_MANUAL_TIMER:
+      set_setting(SETTING_MANUAL_TIMER, command.value);
+      Serial.print("Manual timer updated to ");
+      Serial.print(command.value / 1000);
+      Serial.println(" seconds.");
+      emit(LIGHT_EVENT_MANUAL_TIMER, command.value, fromUi);
+      break;
+  }
+}
+
+static void publish_state() {
+  LightState state;
+  state.lightIsOn = lightIsOn;
+  state.lightManualOverride = lightManualOverride;
+  state.motionDetected = (pirState == HIGH);
+  state.lastMotionTime = lastMotionTime;
+  state.lightOnTime = lightOnTime;
+  state.motionTimerDuration = get_setting(SETTING_MOTION_TIMER);
+  state.manualTimerDuration = get_setting(SETTING_MANUAL_TIMER);
+  lightState.publish(state);
+}
+
+void setup_light_control() {
+  pinMode(PIR_PIN, INPUT);
+  pinMode(LED_PIN, OUTPUT);
+  pinMode(RELAY_PIN, OUTPUT);
+  digitalWrite(LED_PIN, LOW);
+  digitalWrite(RELAY_PIN, LOW);
+  pirState = digitalRead(PIR_PIN);
+  attach_wake_interrupt(PIR_PIN, handle_pir_edge);
+  publish_state();
+}
+
+// Applies the queued PIR edges in order. Returns the timestamp of the latest
+// rising edge, or 0 if there was none.
+static uint32_t drain_pir_edges() {
+  uint32_t risingStartUs = 0;
+  PirEdge edge;
+  while (pirEdges.pop(edge)) {
+    if (edge.level == pirState) continue;  // A glitch that was gone before the ISR read the pin
+    pirState = edge.level;
+    emit(LIGHT_EVENT_MOTION, pirState == HIGH);
+    if (pirState == HIGH) {
+      light_stats_motion();
+      risingStartUs = edge.startUs;
+    }
+  }
+
+  if (pirEdgesOverflowed) {
+    pirEdgesOverflowed = false;
+    int level = digitalRead(PIR_PIN);
+    if (level != pirState) {
+      pirState = level;
+      emit(LIGHT_EVENT_MOTION, pirState == HIGH);
+      if (pirState == HIGH) light_stats_motion();
+    }
+  }
+  return risingStartUs;
+}
+
+void loop_light_control() {
+  LightCommand command;
+  while (uiCommands.pop(command)) apply_command(command, true);
+  while (networkCommands.pop(command)) apply_command(command, false);
+
+  uint32_t motionEdgeStartUs = drain_pir_edges();
+  digitalWrite(LED_PIN, pirState);
+
+  if (!lightManualOverride && pirState == HIGH) {
+    lastMotionTime = millis();
+  }
+
+  unsigned long currentTimerDuration = get_current_timer_duration(lightManualOverride);
+  bool relayShouldBeOn = (millis() - lastMotionTime < currentTimerDuration);
+
+  if (relayShouldBeOn && !lightIsOn) {
+    lightIsOn = true;
+    if (lightManualOverride) {
+        Serial.println("Manual ON: Turning relay ON.");
+    } else {
+        Serial.println("Occupancy detected! Turning relay ON.");
+    }
+    digitalWrite(RELAY_PIN, HIGH);
+    if (motionEdgeStartUs != 0 && !lightManualOverride) profile_end(PROFILE_MOTION, motionEdgeStartUs);
+    lightOnTime = millis();
+    emit(LIGHT_EVENT_RELAY, true);
+    light_stats_relay_changed(true, lightManualOverride);
+  } else if (!relayShouldBeOn && lightIsOn) {
+    lightIsOn = false;
+    Serial.println("Timer expired. Turning relay OFF.");
+    digitalWrite(RELAY_PIN, LOW);
+    emit(LIGHT_EVENT_RELAY, false);
+    light_stats_relay_changed(false, lightManualOverride);
+
+    if (lightManualOverride) {
+      lightManualOverride = false;
+      Serial.println("Manual override timer expired. Returning to auto mode.");
+    }
+  }
+
+  publish_state();
+}
+
+bool send_light_command_from_ui(const LightCommand& command) {
+  return uiCommands.push(command);
+}
+
+bool send_light_command_from_network(const LightCommand& command) {
+  return networkCommands.push(command);
+}
+
+LightState get_light_state() {
+  return lightState.read();
+}
+
+// --- Network Side ---
+static void publish_timer(const char* topic, unsigned long durationMs) {
+  char payload[12];
+  format_unsigned(payload, sizeof(payload), durationMs / 1000);
+  client.publish(topic, payload, true);
+}
+
+static void publish_relay(bool on) {
+  client.publish(MQTT_TOPIC_OCCUPANCY_STATE, on ? "on" : "off");
+  client.publish(MQTT_TOPIC_LIGHT_STATE, on ? "ON" : "OFF");
+}
+
+void publish_light_timers() {
+  LightState state = get_light_state();
+  publish_timer(MQTT_TOPIC_LIGHT_MOTION_TIMER_STATE, state.motionTimerDuration);
+  publish_timer(MQTT_TOPIC_LIGHT_MANUAL_TIMER_STATE, state.manualTimerDuration);
+}
+
+void loop_light_publisher() {
+  LightEvent event;
+  while (events.pop(event)) {
+    switch (event.type) {
+      case LIGHT_EVENT_MOTION:
+        client.publish(MQTT_TOPIC_MOTION_STATE, event.value ? "on" : "off");
+        break;
+      case LIGHT_EVENT_RELAY:
+        publish_relay(event.value);
+        break;
+      case LIGHT_EVENT_MOTION_TIMER:
+        publish_timer(MQTT_TOPIC_LIGHT_MOTION_TIMER_STATE, event.value);
+        // Keep the retained set topic in step so the broker restores it on boot
+        if (event.fromUi) publish_timer(MQTT_TOPIC_LIGHT_MOTION_TIMER_SET, event.value);
+        break;
+      case LIGHT_EVENT_MANUAL_TIMER:
+        publish_timer(MQTT_TOPIC_LIGHT_MANUAL_TIMER_STATE, event.value);
+        if (event.fromUi) publish_timer(MQTT_TOPIC_LIGHT_MANUAL_TIMER_SET, event.value);
+        break;
+    }
+  }
+
+  if (eventsOverflowed.exchange(false, std::memory_order_relaxed)) {
+    LightState state = get_light_state();
+    client.publish(MQTT_TOPIC_MOTION_STATE, state.motionDetected ? "on" : "off");
+    publish_relay(state.lightIsOn);
+    publish_light_timers();
+  }
+}
+
+// --- MQTT Command Handlers (network task) ---
+void handle_lights_command(const char* payload, size_t length) {
+  if (payload_equals(payload, length, "ON")) {
+    send_light_command_from_network({LIGHT_CMD_ON, 0});
+  } else if (payload_equals(payload, length, "OFF")) {
+    send_light_command_from_network({LIGHT_CMD_OFF, 0});
+  }
+}
+
+void handle_motion_timer_command(const char* payload, size_t length) {
+  unsigned long newDurationSec;
+  if (parse_unsigned(payload, length, newDurationSec) && newDurationSec >= 10 && newDurationSec <= 3600) {
+    send_light_command_from_network({LIGHT_CMD_SET_MOTION_TIMER, newDurationSec * 1000});
+  } else {
+    Serial.println("Invalid motion timer value received.");
+  }
+}
+
+void handle_manual_timer_command(const char* payload, size_t length) {
+  unsigned long newDurationSec;
+  if (parse_unsigned(payload, length, newDurationSec) && newDurationSec >= 10 && newDurationSec <= 3600) {
+    send_light_command_from_network({LIGHT_CMD_SET_MANUAL_TIMER, newDurationSec * 1000});
+  } else {
+    Serial.println("Invalid manual timer value received.");
+  }
+}
@@ -0,0 +1,322 @@
+#include <Arduino.h>
+#include <atomic>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include <time.h>
+#include "light_stats.h"
+#include "light_control.h"
+#include "connections.h"
+#include "spsc_queue.h"
+#include "snapshot.h"
+#include "text_format.h"
+#include "config.h"
+
+// --- Hourly Buckets ---
+// One bucket per hour for the last 7 days. Each window keeps a running sum
+// of its buckets: time is credited to the newest bucket and the sums at once,
+// and rolling to a new hour subtracts only the bucket that leaves each
+// window, so nothing ever rescans the ring.
+static const int STATS_BUCKETS = 168;
+static const int STATS_WINDOW_HOURS[LIGHT_STATS_WINDOW_COUNT] = {24, 168};
+static const unsigned long STATS_BUCKET_MS = 3600000UL;
+
+struct StatsBucket {
+  uint32_t relayOnMs;
+  uint32_t occupiedMs;
+  uint16_t switchCount;
+  uint16_t motionEvents;
+};
+
+// Saved to NVS as one blob; bump the version when the layout changes
+struct LightStatsStore {
+  uint32_t version;
+  uint32_t savedEpoch;       // Wall-clock time of the save, 0 if unknown
+  uint32_t bucketElapsedMs;  // How far into the newest bucket the save was
+  uint16_t head;             // Index of the newest bucket
+  uint16_t filled;           // Buckets in use, up to STATS_BUCKETS
+  uint32_t lifetimeSwitchCount;
+  uint64_t lifetimeOnMs;
+  StatsBucket buckets[STATS_BUCKETS];
+};
+
+static const uint32_t LIGHT_STATS_STORE_VERSION = 1;
+static LightStatsStore store;  // Sensor task only
+static Preferences statsPrefs;
+
+struct WindowSums {
+  uint32_t relayOnMs;
+  uint32_t occupiedMs;
+  uint32_t switchCount;
+  uint32_t motionEvents;
+};
+static WindowSums sums[LIGHT_STATS_WINDOW_COUNT];
+
+// --- Edges From the Control Task ---
+enum StatsEventType {
+  STATS_EVENT_RELAY_ON,
+  STATS_EVENT_RELAY_ON_MANUAL,
+  STATS_EVENT_RELAY_OFF,
+  STATS_EVENT_MOTION
+};
+
+struct StatsEvent {
+  StatsEventType type;
+  unsigned long time;
+};
+
+static SpscQueue<StatsEvent, 16> statsEvents;
+// Edges lost to a full queue. The sensor task resyncs from the relay state
+// whenever this moves, so a dropped RELAY_OFF cannot leave the relay counted
+// as on.
+static std::atomic<uint32_t> droppedStatsEvents{0};
+static uint32_t resyncedDrops = 0;  // Sensor task
+
+// --- Running State (sensor task) ---
+static bool relayOn = false;
+static bool occupied = false;         // On because of motion, not a manual override
+static unsigned long lastCreditTime = 0;
+static unsigned long bucketStartTime = 0;
+static unsigned long lastStatsSaveTime = 0;
+static uint32_t catchUpEpoch = 0;     // Saved epoch still to be caught up once SNTP has set the clock
+
+static Snapshot<LightStatsSummary> summarySnapshot;
+static unsigned long lastStatsPublishTime = 0;  // Network task
+
+// Anything added to the newest bucket is inside every window
+static void add_to_sums(const StatsBucket& delta) {
+  for (int w = 0; w < LIGHT_STATS_WINDOW_COUNT; w++) {
+    sums[w].relayOnMs += delta.relayOnMs;
+    sums[w].occupiedMs += delta.occupiedMs;
+    sums[w].switchCount += delta.switchCount;
+    sums[w].motionEvents += delta.motionEvents;
+  }
+}
+
+static void recompute_sums() {
+  memset(sums, 0, sizeof(sums));
+  for (int age = 0; age < store.filled; age++) {
+    const StatsBucket& bucket = store.buckets[(store.head - age + STATS_BUCKETS) % STATS_BUCKETS];
+    for (int w = 0; w < LIGHT_STATS_WINDOW_COUNT; w++) {
+      if (age >= STATS_WINDOW_HOURS[w]) continue;
+      sums[w].relayOnMs += bucket.relayOnMs;
+      sums[w].occupiedMs += bucket.occupiedMs;
+      sums[w].switchCount += bucket.switchCount;
+      sums[w].motionEvents += bucket.motionEvents;
+    }
+  }
+}
+
+// Adds the time since the last credit to whatever is running
+static void credit_running(unsigned long now) {
+  // An edge stamped by the control task just before this pass read millis()
+  // can be older than the last credit; there is nothing to add for it
+  if ((int32_t)(now - lastCreditTime) <= 0) return;
+  uint32_t elapsed = now - lastCreditTime;
+  lastCreditTime = now;
+  if (!relayOn) return;
+
+  StatsBucket delta = {elapsed, occupied ? elapsed : 0, 0, 0};
+  StatsBucket& bucket = store.buckets[store.head];
+  bucket.relayOnMs += delta.relayOnMs;
+  bucket.occupiedMs += delta.occupiedMs;
+  add_to_sums(delta);
+  store.lifetimeOnMs += elapsed;
+}
+
+static void advance_bucket() {
+  store.head = (store.head + 1) % STATS_BUCKETS;
+  if (store.filled < STATS_BUCKETS) store.filled++;
+
+  // The bucket being reused is 7 days old; the one 24 back just left the 24 h window
+  StatsBucket& expired = store.buckets[store.head];
+  for (int w = 0; w < LIGHT_STATS_WINDOW_COUNT; w++) {
+    if (STATS_WINDOW_HOURS[w] == STATS_BUCKETS) {
+      sums[w].relayOnMs -= expired.relayOnMs;
+      sums[w].occupiedMs -= expired.occupiedMs;
+      sums[w].switchCount -= expired.switchCount;
+      sums[w].motionEvents -= expired.motionEvents;
+    } else {
+      const StatsBucket& leaving = store.buckets[(store.head - STATS_WINDOW_HOURS[w] + STATS_BUCKETS) % STATS_BUCKETS];
+      sums[w].relayOnMs -= leaving.relayOnMs;
+      sums[w].occupiedMs -= leaving.occupiedMs;
+      sums[w].switchCount -= leaving.switchCount;
+      sums[w].motionEvents -= leaving.motionEvents;
+    }
+  }
+  memset(&expired, 0, sizeof(expired));
+}
+
+static void apply_event(const StatsEvent& event) {
+  credit_running(event.time);
+  StatsBucket delta = {0, 0, 0, 0};
+  switch (event.type) {
+    case STATS_EVENT_RELAY_ON:
+    case STATS_EVENT_RELAY_ON_MANUAL:
+      if (relayOn) return;
+      relayOn = true;
+      occupied = (event.type == STATS_EVENT_RELAY_ON);
+      delta.switchCount = 1;
+      store.lifetimeSwitchCount++;
+      break;
+    case STATS_EVENT_RELAY_OFF:
+      relayOn = false;
+      occupied = false;
+      return;
+    case STATS_EVENT_MOTION:
+      delta.motionEvents = 1;
+      break;
+  }
+  StatsBucket& bucket = store.buckets[store.head];
+  bucket.switchCount += delta.switchCount;
+  bucket.motionEvents += delta.motionEvents;
+  add_to_sums(delta);
+}
+
+// After a dropped edge the relay may have switched without this side seeing
+// it. Any switch count or motion in the lost edges is gone, but the running
+// time is right again from here on.
+static void resync_relay_state(unsigned long now) {
+  LightState light = get_light_state();
+  StatsEventType type = STATS_EVENT_RELAY_OFF;
+  if (light.lightIsOn) type = light.lightManualOverride ? STATS_EVENT_RELAY_ON_MANUAL : STATS_EVENT_RELAY_ON;
+  apply_event({type, now});
+  if (relayOn) occupied = !light.lightManualOverride;
+}
+
+static uint32_t current_epoch() {
+  time_t now = time(nullptr);
+  return (now < 1700000000) ? 0 : (uint32_t)now;
+}
+
+static void save_light_stats(unsigned long now) {
+  store.savedEpoch = current_epoch();
+  store.bucketElapsedMs = now - bucketStartTime;
+  statsPrefs.putBytes("store", &store, sizeof(store));
+  lastStatsSaveTime = now;
+}
+
+// After a restore the buckets carry on as if no time had passed. Once SNTP
+// has set the clock, move the bucket start back by the time the device was
+// off so loop_light_stats() rolls past those hours.
+static void catch_up_downtime(unsigned long now) {
+  uint32_t epoch = current_epoch();
+  if (catchUpEpoch == 0 || epoch == 0) return;
+
+  uint32_t sinceSave = (epoch > catchUpEpoch) ? epoch - catchUpEpoch : 0;
+  uint32_t uptime = now / 1000;
+  catchUpEpoch = 0;
+  if (sinceSave <= uptime) return;
+
+  uint32_t offSeconds = sinceSave - uptime;
+  if (offSeconds >= STATS_BUCKETS * (STATS_BUCKET_MS / 1000)) {
+    // Off for longer than the whole ring: only the lifetime counters survive
+    memset(store.buckets, 0, sizeof(store.buckets));
+    store.filled = 1;
+    recompute_sums();
+    bucketStartTime = now;
+    return;
+  }
+  bucketStartTime -= offSeconds * 1000UL;
+}
+
+static void publish_summary(unsigned long now) {
+  LightStatsSummary summary;
+  unsigned long intoBucket = now - bucketStartTime;
+  for (int w = 0; w < LIGHT_STATS_WINDOW_COUNT; w++) {
+    // Until the window has filled, rates are over the time actually covered
+    int fullHours = min((int)store.filled, STATS_WINDOW_HOURS[w]) - 1;
+    float coveredMs = (float)fullHours * STATS_BUCKET_MS + intoBucket;
+    LightStatsWindowSummary& out = summary.windows[w];
+    out.relayOnSeconds = sums[w].relayOnMs / 1000;
+    out.switchCount = sums[w].switchCount;
+    out.motionPerHour = coveredMs > 0 ? sums[w].motionEvents * (STATS_BUCKET_MS / coveredMs) : 0.0f;
+    out.occupancyPercent = coveredMs > 0 ? 100.0f * sums[w].occupiedMs / coveredMs : 0.0f;
+  }
+  summary.lifetimeSwitchCount = store.lifetimeSwitchCount;
+  summary.lifetimeOnSeconds = (uint32_t)(store.lifetimeOnMs / 1000);
+  summary.droppedEvents = resyncedDrops;
+  summarySnapshot.publish(summary);
+}
+
+void setup_light_stats() {
+  unsigned long now = millis();
+  statsPrefs.begin("light_stats", false);
+  size_t length = statsPrefs.getBytesLength("store");
+  if (length == sizeof(store) && statsPrefs.getBytes("store", &store, sizeof(store)) == sizeof(store) &&
+      store.version == LIGHT_STATS_STORE_VERSION && store.head < STATS_BUCKETS && store.filled >= 1) {
+    Serial.println("Light statistics restored from NVS.");
+    catchUpEpoch = store.savedEpoch;
+    bucketStartTime = now - min(store.bucketElapsedMs, (uint32_t)STATS_BUCKET_MS);
+  } else {
+    memset(&store, 0, sizeof(store));
+    store.version = LIGHT_STATS_STORE_VERSION;
+    store.filled = 1;
+    bucketStartTime = now;
+    Serial.println("Light statistics initialised.");
+  }
+  recompute_sums();
+  lastCreditTime = now;
+  lastStatsSaveTime = now;
+  lastStatsPublishTime = now;
+  publish_summary(now);
+}
+
+void light_stats_relay_changed(bool on, bool manual) {
+  StatsEvent event = {on ? (manual ? STATS_EVENT_RELAY_ON_MANUAL : STATS_EVENT_RELAY_ON) : STATS_EVENT_RELAY_OFF, millis()};
+  if (!statsEvents.push(event)) droppedStatsEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void light_stats_motion() {
+  StatsEvent event = {STATS_EVENT_MOTION, millis()};
+  if (!statsEvents.push(event)) droppedStatsEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void loop_light_stats() {
+  StatsEvent event;
+  while (statsEvents.pop(event)) apply_event(event);
+
+  unsigned long now = millis();
+  uint32_t dropped = droppedStatsEvents.load(std::memory_order_relaxed);
+  if (dropped != resyncedDrops) {
+    resyncedDrops = dropped;
+    resync_relay_state(now);
+  }
+  credit_running(now);
+  catch_up_downtime(now);
+  while (now - bucketStartTime >= STATS_BUCKET_MS) {
+    advance_bucket();
+    bucketStartTime += STATS_BUCKET_MS;
+  }
+  publish_summary(now);
+
+  if (now - lastStatsSaveTime >= LIGHT_STATS_SAVE_INTERVAL) save_light_stats(now);
+}
+
+LightStatsSummary get_light_stats() {
+  return summarySnapshot.read();
+}
+
+// --- Network Side ---
+void loop_light_stats_publisher() {
+  if (millis() - lastStatsPublishTime < LIGHT_STATS_PUBLISH_INTERVAL) return;
+  lastStatsPublishTime = millis();
+
+  LightStatsSummary summary = get_light_stats();
+  const char* suffixes[LIGHT_STATS_WINDOW_COUNT] = {"24h", "7d"};
+  char buffer[384];
+  TextBuffer payload(buffer, sizeof(buffer));
+  payload.append('{');
+  for (int w = 0; w < LIGHT_STATS_WINDOW_COUNT; w++) {
+    const LightStatsWindowSummary& window = summary.windows[w];
+    payload.append("\"on_h_").append(suffixes[w]).append("\":").append_fixed(window.relayOnSeconds / 3600.0f, 2);
+    payload.append(",\"switches_").append(suffixes[w]).append("\":").append_unsigned(window.switchCount);
+    payload.append(",\"motion_per_h_").append(suffixes[w]).append("\":").append_fixed(window.motionPerHour, 2);
+    payload.append(",\"occupancy_pct_").append(suffixes[w]).append("\":").append_fixed(window.occupancyPercent, 1);
+    payload.append(',');
+  }
+  payload.append("\"switches_total\":").append_unsigned(summary.lifetimeSwitchCount);
+  payload.append(",\"on_h_total\":").append_fixed(summary.lifetimeOnSeconds / 3600.0f, 2);
+  payload.append(",\"events_dropped\":").append_unsigned(summary.droppedEvents);
+  payload.append('}');
+  client.publish(MQTT_TOPIC_LIGHT_STATS_STATE, buffer, true);
+}
@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <atomic>
+#include <PubSubClient.h>
+#include "loop_profiler.h"
+#include "connections.h"
+#include "display_manager.h"
+#include "snapshot.h"
+#include "text_format.h"
+#include "config.h"
+
+// --- Histogram Layout ---
+// Bucket 0 holds sub-microsecond samples; bucket b holds [2^(b-1), 2^b) us.
+// 24 buckets reach ~8 s, beyond which everything lands in the last one.
+static const int PROFILE_BUCKET_COUNT = 24;
+
+struct StageHistogram {
+  uint32_t epoch;   // Window this histogram belongs to
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t buckets[PROFILE_BUCKET_COUNT];
+};
+
+static const char* STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+  "mqtt", "encoder", "input", "lights", "power", "display", "loop", "motion"
+};
+
+// --- Window Handover Between Tasks ---
+// Each stage is only ever timed from one task, which owns its histogram. The
+// reporter never touches them: it bumps windowEpoch, and each owner closes its
+// own window on its next sample and publishes the summary. The report goes
+// out PROFILER_CLOSE_GRACE later, once every stage has had a chance to close.
+// A stage that has not sampled since then (no motion, panel asleep) still
+// holds an older window; its epoch gives it away and it is reported empty.
+static const unsigned long PROFILER_CLOSE_GRACE = 250;
+static const uint32_t NO_REPORTED_EPOCH = UINT32_MAX;
+
+static StageHistogram currentWindow[PROFILE_STAGE_COUNT];
+static Snapshot<ProfileStats> lastWindow[PROFILE_STAGE_COUNT];
+static std::atomic<uint32_t> windowEpoch{0};
+static std::atomic<uint32_t> reportedEpoch{NO_REPORTED_EPOCH};  // Window of the last report
+static unsigned long windowStartTime = 0;
+static bool reportPending = false;
+
+static int bucket_for(uint32_t us) {
+  if (us == 0) return 0;
+  int bucket = 32 - __builtin_clz(us);
+  return (bucket < PROFILE_BUCKET_COUNT) ? bucket : PROFILE_BUCKET_COUNT - 1;
+}
+
+static void reset_histogram(StageHistogram& h, uint32_t epoch) {
+  memset(&h, 0, sizeof(h));
+  h.epoch = epoch;
+  h.minUs = UINT32_MAX;
+}
+
+static ProfileStats summarize(const StageHistogram& h) {
+  ProfileStats stats = {h.epoch, 0, 0, 0, 0, 0};
+  if (h.count == 0) return stats;
+
+  stats.count = h.count;
+  stats.minUs = h.minUs;
+  stats.maxUs = h.maxUs;
+  stats.avgUs = (uint32_t)(h.totalUs / h.count);
+
+  // Walk the buckets until 99% of the samples are covered
+  uint32_t target = h.count - h.count / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < PROFILE_BUCKET_COUNT; b++) {
+    seen += h.buckets[b];
+    if (seen >= target) {
+      uint32_t upperEdge = (b == 0) ? 0 : (1UL << b) - 1;
+      stats.p99Us = min(upperEdge, h.maxUs);
+      break;
+    }
+  }
+  return stats;
+}
+
+// --- Heap Health ---
+// Fragmentation is how much of the free heap is unusable for one allocation:
+// 0% when it is a single block. Formatting is allocation-free, so this should
+// stay flat; a steady climb means something is churning the heap again.
+static uint8_t heap_fragmentation_percent(uint32_t freeBytes, uint32_t largestBlock) {
+  if (freeBytes == 0) return 0;
+  return 100 - (uint8_t)((uint64_t)largestBlock * 100 / freeBytes);
+}
+
+// Stats of the reported window, or empty ones if the stage's latest summary
+// is from another window
+static ProfileStats reported_stats(const ProfileStats& stats) {
+  if (stats.epoch == reportedEpoch.load(std::memory_order_relaxed)) return stats;
+  ProfileStats empty = {stats.epoch, 0, 0, 0, 0, 0};
+  return empty;
+}
+
+// Eight stages with 10-digit timings plus the heap fields come to 575 bytes
+static const size_t PROFILE_SUMMARY_SIZE = 576;
+
+static void publish_summary() {
+  char buffer[PROFILE_SUMMARY_SIZE];
+  TextBuffer payload(buffer, sizeof(buffer));
+  char separator = '{';
+  for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+    // Compact form: [min, avg, max, p99] in microseconds, null with no samples
+    ProfileStats stats = reported_stats(lastWindow[s].read());
+    payload.append(separator).append('"').append(STAGE_NAMES[s]).append("\":");
+    separator = ',';
+    if (stats.count == 0) {
+      payload.append("null");
+      continue;
+    }
+    payload.append('[').append_unsigned(stats.minUs).append(',');
+    payload.append_unsigned(stats.avgUs).append(',');
+    payload.append_unsigned(stats.maxUs).append(',');
+    payload.append_unsigned(stats.p99Us).append(']');
+  }
+  payload.append(",\"loops\":").append_unsigned(reported_stats(lastWindow[PROFILE_LOOP].read()).count);
+  payload.append(",\"oled_bps\":").append_unsigned(get_display_bytes_per_second());
+
+  uint32_t freeBytes = ESP.getFreeHeap();
+  uint32_t largestBlock = ESP.getMaxAllocHeap();
+  payload.append(",\"heap_free\":").append_unsigned(freeBytes);
+  payload.append(",\"heap_min_free\":").append_unsigned(ESP.getMinFreeHeap());
+  payload.append(",\"heap_largest\":").append_unsigned(largestBlock);
+  payload.append(",\"heap_frag_pct\":").append_unsigned(heap_fragmentation_percent(freeBytes, largestBlock));
+  payload.append('}');
+
+  if (payload.overflowed()) {
+    Serial.println("Loop profile summary truncated, not published.");
+    return;
+  }
+  client.publish(MQTT_TOPIC_DIAGNOSTICS_LOOP, buffer);
+}
+
+// Timed on the esp_timer clock (micros()), not CPU cycles: the saving power
+// modes change the CPU clock on the fly and stop the cycle counter in light
+// sleep. Also called from the PIR interrupt, hence IRAM.
+uint32_t IRAM_ATTR profile_start() {
+  return micros();
+}
+
+void profile_end(ProfileStage stage, uint32_t startUs) {
+  uint32_t us = micros() - startUs;
+  StageHistogram& h = currentWindow[stage];
+  uint32_t epoch = windowEpoch.load(std::memory_order_acquire);
+  if (h.epoch != epoch) {
+    lastWindow[stage].publish(summarize(h));
+    reset_histogram(h, epoch);
+  }
+  h.count++;
+  h.totalUs += us;
+  if (us < h.minUs) h.minUs = us;
+  if (us > h.maxUs) h.maxUs = us;
+  h.buckets[bucket_for(us)]++;
+}
+
+void setup_profiler() {
+  for (int s = 0; s < PROFILE_STAGE_COUNT; s++) reset_histogram(currentWindow[s], 0);
+  windowStartTime = millis();
+}
+
+void loop_profiler() {
+  if (reportPending && millis() - windowStartTime >= PROFILER_CLOSE_GRACE) {
+    reportPending = false;
+    reportedEpoch.store(windowEpoch.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    publish_summary();
+  }
+  if (millis() - windowStartTime < PROFILER_REPORT_INTERVAL) return;
+  windowStartTime = millis();
+  windowEpoch.fetch_add(1, std::memory_order_release);
+  reportPending = true;
+}
+
+bool get_profile_stats(ProfileStage stage, ProfileStats& stats) {
+  ProfileStats latest;
+  if (!lastWindow[stage].try_read(latest)) return false;
+  stats = reported_stats(latest);
+  return true;
+}
+
+const char* get_profile_stage_name(ProfileStage stage) {
+  return STAGE_NAMES[stage];
+}
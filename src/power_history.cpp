@@ -0,0 +1,276 @@
+#include <Arduino.h>
+#include <atomic>
+#include <PubSubClient.h>
+#include "power_history.h"
+#include "connections.h"
+#include "utils.h"
+#include "config.h"
+
+// --- Fixed-Point Storage ---
+// Every value is packed into an int16: voltage in mV, current in mA and power
+// in 10 mW steps, which covers +/-32 V, +/-32 A and +/-327 W.
+static const float HISTORY_SCALE[HISTORY_QUANTITY_COUNT] = {1000.0f, 1.0f, 0.1f};
+
+struct PackedPoint {
+  int16_t min;
+  int16_t mean;
+  int16_t max;
+};
+
+// One slot holds every quantity of every channel: 3 x 3 x 6 = 54 bytes
+struct HistorySlot {
+  PackedPoint points[3][HISTORY_QUANTITY_COUNT];
+};
+
+// Running min/max/sum of whatever is being folded into the next slot of a tier
+struct SlotAccumulator {
+  float min[3][HISTORY_QUANTITY_COUNT];
+  float max[3][HISTORY_QUANTITY_COUNT];
+  float sum[3][HISTORY_QUANTITY_COUNT];
+  uint16_t count;
+  unsigned long startTime;
+};
+
+struct TierRing {
+  HistorySlot* slots;
+  int capacity;
+  int head;   // Index the next slot is written to
+  int count;
+  uint32_t sequence;
+  unsigned long slotDuration;
+};
+
+static HistorySlot slots1s[HISTORY_1S_SLOTS];
+static HistorySlot slots1min[HISTORY_1MIN_SLOTS];
+static HistorySlot slots15min[HISTORY_15MIN_SLOTS];
+
+static TierRing tiers[HISTORY_TIER_COUNT] = {
+  {slots1s, HISTORY_1S_SLOTS, 0, 0, 0, 1000UL},
+  {slots1min, HISTORY_1MIN_SLOTS, 0, 0, 0, 60000UL},
+  {slots15min, HISTORY_15MIN_SLOTS, 0, 0, 0, 900000UL},
+};
+
+static SlotAccumulator accumulators[HISTORY_TIER_COUNT];  // Sensor task only
+static bool historyStarted = false;
+
+// The rings are written by the sensor task and read by the UI and network
+// tasks. Writes happen inside an odd ringWriteSequence, so readers retry a
+// slot that changed under them (same scheme as Snapshot<T>).
+static std::atomic<uint32_t> ringWriteSequence{0};
+
+static int16_t pack(float value, HistoryQuantity quantity) {
+  float scaled = value * HISTORY_SCALE[quantity];
+  if (scaled > 32767.0f) return 32767;
+  if (scaled < -32768.0f) return -32768;
+  return (int16_t)lroundf(scaled);
+}
+
+static float unpack(int16_t value, HistoryQuantity quantity) {
+  return value / HISTORY_SCALE[quantity];
+}
+
+static void reset_accumulator(SlotAccumulator& acc, unsigned long now) {
+  for (int ch = 0; ch < 3; ch++) {
+    for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+      acc.min[ch][q] = INFINITY;
+      acc.max[ch][q] = -INFINITY;
+      acc.sum[ch][q] = 0.0f;
+    }
+  }
+  acc.count = 0;
+  acc.startTime = now;
+}
+
+// Folds one min/mean/max triple per channel and quantity into an accumulator
+static void accumulate(SlotAccumulator& acc, const HistoryPoint values[3][HISTORY_QUANTITY_COUNT]) {
+  for (int ch = 0; ch < 3; ch++) {
+    for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+      acc.min[ch][q] = min(acc.min[ch][q], values[ch][q].min);
+      acc.max[ch][q] = max(acc.max[ch][q], values[ch][q].max);
+      acc.sum[ch][q] += values[ch][q].mean;
+    }
+  }
+  acc.count++;
+}
+
+static void close_slot(int tier, unsigned long now) {
+  SlotAccumulator& acc = accumulators[tier];
+  TierRing& ring = tiers[tier];
+
+  if (acc.count > 0) {
+    HistoryPoint closed[3][HISTORY_QUANTITY_COUNT];
+    uint32_t sequence = ringWriteSequence.load(std::memory_order_relaxed);
+    ringWriteSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    HistorySlot& slot = ring.slots[ring.head];
+    for (int ch = 0; ch < 3; ch++) {
+      for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+        closed[ch][q].min = acc.min[ch][q];
+        closed[ch][q].mean = acc.sum[ch][q] / acc.count;
+        closed[ch][q].max = acc.max[ch][q];
+        slot.points[ch][q].min = pack(closed[ch][q].min, (HistoryQuantity)q);
+        slot.points[ch][q].mean = pack(closed[ch][q].mean, (HistoryQuantity)q);
+        slot.points[ch][q].max = pack(closed[ch][q].max, (HistoryQuantity)q);
+      }
+    }
+    ring.head = (ring.head + 1) % ring.capacity;
+    if (ring.count < ring.capacity) ring.count++;
+    ring.sequence++;
+    ringWriteSequence.store(sequence + 2, std::memory_order_release);
+
+    if (tier + 1 < HISTORY_TIER_COUNT) {
+      accumulate(accumulators[tier + 1], closed);
+    }
+  }
+
+  // Keep slot boundaries on a fixed grid unless we fell more than a slot behind
+  unsigned long nextStart = acc.startTime + ring.slotDuration;
+  reset_accumulator(acc, (now - nextStart < ring.slotDuration) ? nextStart : now);
+}
+
+void history_record_sample(const float busVoltage[3], const float current[3], const float power[3]) {
+  unsigned long now = millis();
+  if (!historyStarted) {
+    for (int t = 0; t < HISTORY_TIER_COUNT; t++) reset_accumulator(accumulators[t], now);
+    historyStarted = true;
+  }
+
+  // Close every tier whose period has run out, lowest first so the closed
+  // slot cascades into the tier above before that one is checked.
+  for (int t = 0; t < HISTORY_TIER_COUNT; t++) {
+    if (now - accumulators[t].startTime >= tiers[t].slotDuration) {
+      close_slot(t, now);
+    }
+  }
+
+  HistoryPoint sample[3][HISTORY_QUANTITY_COUNT];
+  for (int ch = 0; ch < 3; ch++) {
+    sample[ch][HISTORY_VOLTAGE] = {busVoltage[ch], busVoltage[ch], busVoltage[ch]};
+    sample[ch][HISTORY_CURRENT] = {current[ch], current[ch], current[ch]};
+    sample[ch][HISTORY_POWER] = {power[ch], power[ch], power[ch]};
+  }
+  accumulate(accumulators[HISTORY_1S], sample);
+}
+
+int history_count(HistoryTier tier) {
+  return tiers[tier].count;
+}
+
+bool history_get(HistoryTier tier, int channel, HistoryQuantity quantity, int age, HistoryPoint& out) {
+  const TierRing& ring = tiers[tier];
+  if (channel < 1 || channel > 3 || age < 0) return false;
+
+  PackedPoint point;
+  uint32_t before, after;
+  do {
+    before = ringWriteSequence.load(std::memory_order_acquire);
+    if (age >= ring.count) return false;
+    int index = (ring.head - 1 - age + ring.capacity) % ring.capacity;
+    point = ring.slots[index].points[channel - 1][quantity];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = ringWriteSequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+
+  out.min = unpack(point.min, quantity);
+  out.mean = unpack(point.mean, quantity);
+  out.max = unpack(point.max, quantity);
+  return true;
+}
+
+uint32_t history_sequence(HistoryTier tier) {
+  return tiers[tier].sequence;
+}
+
+// --- MQTT History Query (network task) ---
+// The reply is copied out of the ring in one consistent read and written by
+// hand, so a query costs no heap. Static rather than on the network task's stack.
+struct HistoryReply {
+  int channel;
+  HistoryTier tier;
+  int count;
+  PackedPoint points[HISTORY_1S_SLOTS][HISTORY_QUANTITY_COUNT];  // Oldest first
+};
+
+static HistoryReply reply;
+
+static const char* const TIER_NAMES[HISTORY_TIER_COUNT] = {"1s", "1m", "15m"};
+static const char* const QUANTITY_KEYS[HISTORY_QUANTITY_COUNT] = {"mv", "ma", "mw"};
+// Packed units to the integers in the reply: mV, mA, mW
+static const long REPLY_MULTIPLIER[HISTORY_QUANTITY_COUNT] = {1, 1, 10};
+
+static void copy_history(HistoryTier tier, int channel) {
+  const TierRing& ring = tiers[tier];
+  uint32_t before, after;
+  do {
+    before = ringWriteSequence.load(std::memory_order_acquire);
+    reply.count = ring.count;
+    for (int i = 0; i < reply.count; i++) {
+      int index = (ring.head - reply.count + i + ring.capacity) % ring.capacity;
+      for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+        reply.points[i][q] = ring.slots[index].points[channel - 1][q];
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = ringWriteSequence.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  reply.channel = channel;
+  reply.tier = tier;
+}
+
+// {"ch":2,"tier":"1m","period_s":60,"mv":[[min,mean,max],...],"ma":[...],"mw":[...]}
+static void render_history_reply(Print& out) {
+  out.print("{\"ch\":");
+  out.print(reply.channel);
+  out.print(",\"tier\":\"");
+  out.print(TIER_NAMES[reply.tier]);
+  out.print("\",\"period_s\":");
+  out.print(tiers[reply.tier].slotDuration / 1000);
+  for (int q = 0; q < HISTORY_QUANTITY_COUNT; q++) {
+    out.print(",\"");
+    out.print(QUANTITY_KEYS[q]);
+    out.print("\":[");
+    for (int i = 0; i < reply.count; i++) {
+      const PackedPoint& point = reply.points[i][q];
+      if (i > 0) out.print(',');
+      out.print('[');
+      out.print(point.min * REPLY_MULTIPLIER[q]);
+      out.print(',');
+      out.print(point.mean * REPLY_MULTIPLIER[q]);
+      out.print(',');
+      out.print(point.max * REPLY_MULTIPLIER[q]);
+      out.print(']');
+    }
+    out.print(']');
+  }
+  out.print('}');
+}
+
+void handle_history_command(const char* payload, size_t length) {
+  // "<channel>" or "<channel> <tier>"; the tier defaults to 1s
+  size_t separator = 0;
+  while (separator < length && payload[separator] != ' ') separator++;
+  size_t tierStart = separator;
+  while (tierStart < length && payload[tierStart] == ' ') tierStart++;
+
+  unsigned long channel;
+  if (!parse_unsigned(payload, separator, channel) || channel < 1 || channel > 3) {
+    Serial.println("Invalid history channel requested.");
+    return;
+  }
+
+  int tier = HISTORY_1S;
+  if (tierStart < length) {
+    for (tier = 0; tier < HISTORY_TIER_COUNT; tier++) {
+      if (payload_equals(payload + tierStart, length - tierStart, TIER_NAMES[tier])) break;
+    }
+    if (tier == HISTORY_TIER_COUNT) {
+      Serial.println("Invalid history tier requested.");
+      return;
+    }
+  }
+
+  copy_history((HistoryTier)tier, (int)channel);
+  // Streamed, so the reply does not have to fit the client's packet buffer
+  publish_streamed(MQTT_TOPIC_HISTORY_STATE, render_history_reply, false);
+}
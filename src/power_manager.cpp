@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <atomic>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#ifndef NATIVE_BUILD
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <soc/gpio_struct.h>
+#endif
+#include "power_manager.h"
+#include "power_monitor.h"
+#include "battery_soc.h"
+#include "connections.h"
+#include "snapshot.h"
+#include "text_format.h"
+#include "config.h"
+
+// --- Mode Table ---
+// Light sleep is automatic: whenever every task is blocked in its period
+// delay, the idle task sleeps until the next task wakes, a GPIO wake level or
+// a Wi-Fi DTIM beacon. Stretching the task periods makes those sleeps longer.
+struct PowerModeSpec {
+  const char* name;
+  int maxCpuMhz;
+  int minCpuMhz;            // Clock while only idle-time work is left
+  bool lightSleep;
+  wifi_ps_type_t wifiSleep; // MIN_MODEM wakes for every DTIM, MAX_MODEM every listen interval (3 beacons)
+  uint32_t taskPeriodScale;
+  // Controller draw (ESP32-C6, OLED, PIR) from datasheet figures, reported
+  // in place of a measurement when no SELF_POWER_CHANNEL is fitted
+  float estimatedMilliwatts;
+};
+
+static const PowerModeSpec POWER_MODES[POWER_MODE_COUNT] = {
+  {"full", 160, 160, false, WIFI_PS_MIN_MODEM, 1, 150.0f},  // ~38 mA modem sleep + ~8 mA OLED at 3.3 V
+  {"save", 160, 40, true, WIFI_PS_MIN_MODEM, 2, 60.0f},     // Light sleep, waking for every DTIM
+  {"low", 80, 40, true, WIFI_PS_MAX_MODEM, 5, 35.0f},       // Light sleep, every third beacon
+};
+
+// --- Status (sensor task -> network task) ---
+struct PowerManagerStatus {
+  PowerMode mode;
+  float batteryVolts;                     // Diagnostic only, see averageBatteryVolts
+  uint16_t socPermille;                   // What the mode was picked from
+  bool socValid;
+  bool batteryFitted;                     // False: modes stay at full, there is nothing to pick them from
+  uint32_t modeChanges;
+  uint32_t modeSeconds[POWER_MODE_COUNT]; // Time spent in each mode since boot
+  float selfMilliwatts[POWER_MODE_COUNT]; // Controller's average draw in each mode, NaN if never measured in it
+  float selfMilliwattsAverage;            // The same over all modes, weighted by time
+};
+
+static Snapshot<PowerManagerStatus> statusSnapshot;
+static std::atomic<uint32_t> taskPeriodScale{1};
+
+// --- Sensor Task State ---
+static PowerMode currentMode = POWER_MODE_FULL;
+static uint32_t modeChanges = 0;
+static unsigned long lastPassTime = 0;
+static unsigned long lastCheckTime = 0;
+// Diagnostic only: the modes follow the state of charge, this just reports
+// the battery voltage they were picked at (0 if the channel is not fitted)
+static double voltageSum = 0;       // Battery voltage samples since the last check
+static uint32_t voltageSamples = 0;
+static float averageBatteryVolts = 0;
+static BatteryState lastBattery = {};
+static uint64_t modeMillis[POWER_MODE_COUNT];
+static double selfMilliwattMillis[POWER_MODE_COUNT];  // Controller energy per mode, mW x ms
+
+// Measured when a channel carries only the controller's supply, else estimated
+static bool self_power_measured() {
+  return SELF_POWER_CHANNEL != 0 && power_channel_fitted(SELF_POWER_CHANNEL);
+}
+
+static unsigned long lastStatusPublishTime = 0;  // Network task
+
+// --- Wake-Capable Pin Interrupts ---
+void attach_wake_interrupt(int pin, void (*isr)()) {
+#ifdef NATIVE_BUILD
+  attachInterrupt(digitalPinToInterrupt(pin), isr, CHANGE);
+#else
+  bool high = digitalRead(pin);
+  attachInterrupt(digitalPinToInterrupt(pin), isr, high ? ONLOW : ONHIGH);
+  gpio_wakeup_enable((gpio_num_t)pin, high ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+#endif
+}
+
+void IRAM_ATTR rearm_wake_interrupt(int pin, int level) {
+#ifndef NATIVE_BUILD
+  gpio_ll_set_intr_type(&GPIO, pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+#else
+  (void)pin;
+  (void)level;
+#endif
+}
+
+// --- Mode Selection ---
+// The state of charge rather than the voltage: a LiFePO4 pack sits on a flat
+// 13.2 V for most of its capacity, so no voltage threshold would work for
+// every chemistry. Leaving a deeper mode needs the charge back above its
+// threshold plus the hysteresis, so a battery resting on a threshold doesn't
+// flip modes.
+static PowerMode select_mode(const BatteryState& battery) {
+  if (!battery.valid) return POWER_MODE_FULL;  // No battery reading to go on
+  uint16_t lowBelow = POWER_LOW_BELOW_PERCENT * 10;
+  uint16_t saveBelow = POWER_SAVE_BELOW_PERCENT * 10;
+  if (currentMode >= POWER_MODE_LOW) lowBelow += POWER_MODE_HYSTERESIS_PERCENT * 10;
+  if (currentMode >= POWER_MODE_SAVE) saveBelow += POWER_MODE_HYSTERESIS_PERCENT * 10;
+  if (battery.socPermille < lowBelow) return POWER_MODE_LOW;
+  if (battery.socPermille < saveBelow) return POWER_MODE_SAVE;
+  return POWER_MODE_FULL;
+}
+
+static void apply_mode(PowerMode mode) {
+  const PowerModeSpec& spec = POWER_MODES[mode];
+#ifndef NATIVE_BUILD
+  esp_pm_config_t config = {};
+  config.max_freq_mhz = spec.maxCpuMhz;
+  config.min_freq_mhz = spec.minCpuMhz;
+  config.light_sleep_enable = spec.lightSleep;
+  esp_err_t err = esp_pm_configure(&config);
+  if (err != ESP_OK && spec.lightSleep) {
+    // Core built without tickless idle: frequency scaling still helps
+    config.light_sleep_enable = false;
+    err = esp_pm_configure(&config);
+  }
+  if (err != ESP_OK) {
+    Serial.print("Power management unavailable: ");
+    Serial.println(esp_err_to_name(err));
+  }
+#endif
+  WiFi.setSleep(spec.wifiSleep);
+  taskPeriodScale.store(spec.taskPeriodScale, std::memory_order_relaxed);
+  Serial.print("Power mode: ");
+  Serial.println(spec.name);
+}
+
+static void publish_status() {
+  PowerManagerStatus status;
+  status.mode = currentMode;
+  status.batteryVolts = averageBatteryVolts;
+  status.socPermille = lastBattery.socPermille;
+  status.socValid = lastBattery.valid;
+  status.batteryFitted = power_channel_fitted(POWER_BATTERY_CHANNEL);
+  status.modeChanges = modeChanges;
+  uint64_t totalMillis = 0;
+  double totalMilliwattMillis = 0;
+  for (int m = 0; m < POWER_MODE_COUNT; m++) {
+    status.modeSeconds[m] = modeMillis[m] / 1000;
+    if (modeMillis[m]) status.selfMilliwatts[m] = selfMilliwattMillis[m] / modeMillis[m];
+    else status.selfMilliwatts[m] = self_power_measured() ? NAN : POWER_MODES[m].estimatedMilliwatts;
+    totalMillis += modeMillis[m];
+    totalMilliwattMillis += selfMilliwattMillis[m];
+  }
+  status.selfMilliwattsAverage = totalMillis ? totalMilliwattMillis / totalMillis : 0;
+  statusSnapshot.publish(status);
+}
+
+void setup_power_manager() {
+#ifndef NATIVE_BUILD
+  esp_sleep_enable_gpio_wakeup();
+#endif
+  if (!power_channel_fitted(POWER_BATTERY_CHANNEL)) {
+    Serial.println("Battery channel not fitted: power modes stay at full.");
+  }
+  apply_mode(currentMode);
+  lastPassTime = lastCheckTime = millis();
+  publish_status();
+}
+
+void loop_power_manager() {
+  unsigned long now = millis();
+  unsigned long elapsed = now - lastPassTime;
+  lastPassTime = now;
+
+  // Every pass is charged to the mode it ran in
+  modeMillis[currentMode] += elapsed;
+  float selfMilliwatts = self_power_measured() ? get_power(SELF_POWER_CHANNEL) : POWER_MODES[currentMode].estimatedMilliwatts;
+  selfMilliwattMillis[currentMode] += (double)selfMilliwatts * elapsed;
+  if (power_channel_fitted(POWER_BATTERY_CHANNEL)) {
+    voltageSum += get_bus_voltage(POWER_BATTERY_CHANNEL);
+    voltageSamples++;
+  }
+
+  if (now - lastCheckTime < POWER_MODE_CHECK_INTERVAL) return;
+  lastCheckTime = now;
+
+  averageBatteryVolts = voltageSamples ? voltageSum / voltageSamples : 0;
+  voltageSum = 0;
+  voltageSamples = 0;
+
+  lastBattery = get_battery_state();
+  PowerMode mode = select_mode(lastBattery);
+  if (mode != currentMode) {
+    currentMode = mode;
+    modeChanges++;
+    apply_mode(mode);
+  }
+  publish_status();
+}
+
+PowerMode get_power_mode() {
+  return statusSnapshot.read().mode;
+}
+
+uint32_t get_task_period_scale() {
+  return taskPeriodScale.load(std::memory_order_relaxed);
+}
+
+// --- Network Side ---
+void loop_power_manager_publisher() {
+  if (millis() - lastStatusPublishTime < POWER_MANAGER_PUBLISH_INTERVAL) return;
+  lastStatusPublishTime = millis();
+
+  PowerManagerStatus status = statusSnapshot.read();
+  char buffer[384];
+  TextBuffer payload(buffer, sizeof(buffer));
+  payload.append("{\"mode\":\"").append(POWER_MODES[status.mode].name).append('"');
+  payload.append(",\"battery_fitted\":").append(status.batteryFitted ? "true" : "false");
+  payload.append(",\"battery_v\":").append_fixed(status.batteryVolts, 3);
+  payload.append(",\"battery_soc_pct\":");
+  if (status.socValid) payload.append_fixed(status.socPermille / 10.0f, 1);
+  else payload.append("null");
+  payload.append(",\"mode_changes\":").append_unsigned(status.modeChanges);
+  for (int m = 0; m < POWER_MODE_COUNT; m++) {
+    payload.append(",\"").append(POWER_MODES[m].name).append("_s\":").append_unsigned(status.modeSeconds[m]);
+  }
+  // The controller's draw per mode, metered or from the mode table
+  payload.append(",\"self_mw_source\":").append(self_power_measured() ? "\"measured\"" : "\"estimated\"");
+  for (int m = 0; m < POWER_MODE_COUNT; m++) {
+    payload.append(",\"self_mw_").append(POWER_MODES[m].name).append("\":");
+    payload.append_fixed(status.selfMilliwatts[m], 1);
+  }
+  payload.append(",\"self_mw_avg\":").append_fixed(status.selfMilliwattsAverage, 1);
+  payload.append('}');
+  client.publish(MQTT_TOPIC_DIAGNOSTICS_POWER, buffer, true);
+}
@@ -1,10 +1,15 @@
 #include <Arduino.h>
 #include <Wire.h> 
 #include <INA226.h>
-#include <ArduinoJson.h>
 #include <PubSubClient.h>
 #include "connections.h"
 #include "power_monitor.h"
+#include "snapshot.h"
+#include "power_history.h"
+#include "energy_counter.h"
+#include "battery_soc.h"
+#include "power_manager.h"
+#include "text_format.h"
 #include "config.h"
 
 // --- DECLARED AS POINTERS ---
@@ -12,15 +17,230 @@ INA226 *ina_ch1;
 // INA226 *ina_ch2;
 INA226 *ina_ch3;
 
-// Variables to hold the latest sensor readings for all 3 channels
-float busVoltage[3] = {0.0, 0.0, 0.0};
-float current[3] = {0.0, 0.0, 0.0};
-float power[3] = {0.0, 0.0, 0.0};
+// Variables to hold the latest sensor readings for all 3 channels (sensor task)
+static float busVoltage[3] = {0.0, 0.0, 0.0};
+static float current[3] = {0.0, 0.0, 0.0};
+static float power[3] = {0.0, 0.0, 0.0};
+
+// What every other task sees of them
+static Snapshot<PowerReadings> readingsSnapshot;
 
 // Non-blocking timer for sensor reads
 unsigned long lastSensorReadTime = 0;
 const int SENSOR_READ_INTERVAL = 250; // Read sensors every 250ms
 
+// --- Channel Table ---
+// CH2 (Battery) is not fitted yet; flip its entry once the sensor is wired.
+static const bool CHANNEL_FITTED[3] = {true, false, true};
+static const uint8_t CHANNEL_ADDRESS[3] = {INA226_CH1_ADDRESS, INA226_CH2_ADDRESS, INA226_CH3_ADDRESS};
+static const float CHANNEL_SHUNT[3] = {INA226_CH1_SHUNT, INA226_CH2_SHUNT, INA226_CH3_SHUNT};
+static const char* const CHANNEL_TOPIC[3] = {MQTT_TOPIC_POWER_CH1_STATE, MQTT_TOPIC_POWER_CH2_STATE, MQTT_TOPIC_POWER_CH3_STATE};
+
+// --- INA226 Registers ---
+// The INA226 has no register auto-increment, so each register is fetched as
+// one pointer-write + repeated-start read transaction. Power is derived from
+// bus and shunt voltage on this side, which saves a third register read and
+// keeps the result independent of the calibration register.
+static const uint8_t INA226_REG_SHUNT_VOLTAGE = 0x01;
+static const uint8_t INA226_REG_BUS_VOLTAGE = 0x02;
+static const uint8_t INA226_REG_MASK_ENABLE = 0x06;
+static const uint16_t INA226_MASK_CVRF = 0x0008;      // Conversion Ready Flag, cleared by reading MASK_ENABLE
+static const float INA226_SHUNT_LSB_V = 0.0000025f;    // 2.5 uV
+static const float INA226_BUS_LSB_V = 0.00125f;        // 1.25 mV
+
+// --- Conversion-Ready Alert ---
+// Set by the ISR when any INA226 pulls the shared ALERT line low.
+static volatile bool alertPending = false;
+
+// In alert mode each conversion averages 256 bus/shunt pairs of 1.1 ms each,
+// so a reading covers the whole ~563 ms since the last one and each device
+// interrupts at that rate, not every 35 ms as with the polled 16 averages.
+static const ina226_averages_t INA226_ALERT_AVERAGES = INA226_AVERAGES_256;
+static const unsigned long INA226_CONVERSION_MS = 563;  // 256 x (1.1 + 1.1) ms
+// A channel is only asked for CVRF once most of its period has passed (the
+// INA226 timebase is good to a few percent); until then the alert is another
+// device's and costs this one no bus time.
+static const unsigned long INA226_CONVERSION_DUE_MS = INA226_CONVERSION_MS * 9 / 10;
+static unsigned long channelReadTime[3];
+// --- Report-by-Exception State (network task) ---
+// The values last sent for each channel, compared against POWER_DEADBANDS.
+static float publishedVoltage[3];
+static float publishedCurrent[3];
+static float publishedPower[3];
+static unsigned long lastPublishTime[3];
+static bool hasPublished[3] = {false, false, false};
+static uint32_t lastCheckedVersion = 0;
+
+static bool outside_deadband(float value, float published, float absBand, float pctBand) {
+  float band = max(absBand, fabsf(published) * pctBand / 100.0f);
+  return fabsf(value - published) > band;
+}
+
+// True if a channel moved past its deadband or its heartbeat is due.
+// Channels are 0-based here.
+static bool channel_needs_publish(int ch, const PowerReadings& readings) {
+  const PowerDeadband& band = POWER_DEADBANDS[ch];
+  bool due = !hasPublished[ch] || (millis() - lastPublishTime[ch] >= POWER_PUBLISH_HEARTBEAT);
+  bool changed = outside_deadband(readings.busVoltage[ch], publishedVoltage[ch], band.voltageAbs, band.voltagePct) ||
+                 outside_deadband(readings.current[ch], publishedCurrent[ch], band.currentAbs, band.currentPct) ||
+                 outside_deadband(readings.power[ch], publishedPower[ch], band.powerAbs, band.powerPct);
+  return due || changed;
+}
+
+// Only remember the values once the broker has actually taken them
+static void remember_published(int ch, const PowerReadings& readings) {
+  publishedVoltage[ch] = readings.busVoltage[ch];
+  publishedCurrent[ch] = readings.current[ch];
+  publishedPower[ch] = readings.power[ch];
+  lastPublishTime[ch] = millis();
+  hasPublished[ch] = true;
+}
+
+// {"bus_voltage":12.345,"current":678.9,"power":8380.1}, the same precision
+// for the per-channel topics and the batched message
+static const uint8_t VOLTAGE_DECIMALS = 3;  // 1 mV, near the INA226 bus LSB
+static const uint8_t CURRENT_DECIMALS = 1;  // 0.1 mA
+static const uint8_t POWER_DECIMALS = 1;    // 0.1 mW
+
+static void append_channel_json(TextBuffer& payload, int ch, const PowerReadings& readings) {
+  payload.append("{\"bus_voltage\":").append_fixed(readings.busVoltage[ch], VOLTAGE_DECIMALS);
+  payload.append(",\"current\":").append_fixed(readings.current[ch], CURRENT_DECIMALS);
+  payload.append(",\"power\":").append_fixed(readings.power[ch], POWER_DECIMALS);
+  payload.append('}');
+}
+
+static void publish_channel_if_changed(int ch, const char* topic, const PowerReadings& readings) {
+  if (!channel_needs_publish(ch, readings)) return;
+
+  char buffer[96];
+  TextBuffer payload(buffer, sizeof(buffer));
+  append_channel_json(payload, ch, readings);
+
+  if (client.publish(topic, buffer, true)) remember_published(ch, readings);
+}
+
+// --- Batched Telemetry (network task) ---
+// One message carries every fitted channel, so a sample costs one publish
+// and usually one TCP segment instead of one per channel.
+static uint32_t batchSequence = 0;
+
+static size_t format_batch_json(char* buffer, size_t size, const PowerReadings& readings) {
+  TextBuffer payload(buffer, size);
+  payload.append("{\"seq\":").append_unsigned(batchSequence);
+  payload.append(",\"uptime_ms\":").append_unsigned(millis());
+  for (int ch = 0; ch < 3; ch++) {
+    if (!CHANNEL_FITTED[ch]) continue;
+    payload.append(",\"ch").append_unsigned(ch + 1).append("\":");
+    append_channel_json(payload, ch, readings);
+  }
+  payload.append('}');
+  return payload.length();
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
+
+static void put_float(uint8_t* out, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put_u32(out, bits);
+}
+
+static void format_batch_packed(uint8_t* out, const PowerReadings& readings) {
+  memset(out, 0, POWER_PACKED_BYTES);
+  out[0] = POWER_PACKED_VERSION;
+  for (int ch = 0; ch < 3; ch++) {
+    if (CHANNEL_FITTED[ch]) out[1] |= 1 << ch;
+  }
+  put_u32(out + 2, batchSequence);
+  put_u32(out + 6, millis());
+  for (int ch = 0; ch < 3; ch++) {
+    if (!CHANNEL_FITTED[ch]) continue;
+    uint8_t* slot = out + POWER_PACKED_HEADER_BYTES + ch * POWER_PACKED_CHANNEL_BYTES;
+    put_float(slot, readings.busVoltage[ch]);
+    put_float(slot + 4, readings.current[ch]);
+    put_float(slot + 8, readings.power[ch]);
+  }
+}
+
+// Sends all channels together once any one of them needs publishing.
+static void publish_batch_if_changed(const PowerReadings& readings) {
+  bool needed = false;
+  for (int ch = 0; ch < 3; ch++) {
+    if (CHANNEL_FITTED[ch] && channel_needs_publish(ch, readings)) needed = true;
+  }
+  if (!needed) return;
+
+  bool sent;
+  if (POWER_TELEMETRY_MODE == POWER_TELEMETRY_PACKED) {
+    uint8_t payload[POWER_PACKED_BYTES];
+    format_batch_packed(payload, readings);
+    sent = client.publish(MQTT_TOPIC_POWER_STATE, payload, sizeof(payload), true);
+  } else {
+    char payload[256];
+    format_batch_json(payload, sizeof(payload), readings);
+    sent = client.publish(MQTT_TOPIC_POWER_STATE, payload, true);
+  }
+
+  if (sent) {
+    batchSequence++;
+    for (int ch = 0; ch < 3; ch++) {
+      if (CHANNEL_FITTED[ch]) remember_published(ch, readings);
+    }
+  }
+}
+
+static bool read_register(uint8_t address, uint8_t reg, uint16_t& value) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return false; // Repeated start, no STOP
+  if (Wire.requestFrom((int)address, 2) != 2) return false;
+  value = (uint16_t)(Wire.read() << 8);
+  value |= (uint16_t)Wire.read();
+  return true;
+}
+
+// Reads bus and shunt voltage for one channel and derives current and power.
+// On a bus error the previous reading is kept.
+static void read_channel(int ch) {
+  uint16_t busRaw, shuntRaw;
+  if (!read_register(CHANNEL_ADDRESS[ch], INA226_REG_BUS_VOLTAGE, busRaw)) return;
+  if (!read_register(CHANNEL_ADDRESS[ch], INA226_REG_SHUNT_VOLTAGE, shuntRaw)) return;
+
+  busVoltage[ch] = busRaw * INA226_BUS_LSB_V;
+  current[ch] = (int16_t)shuntRaw * INA226_SHUNT_LSB_V / CHANNEL_SHUNT[ch] * 1000; // Milliamps
+  power[ch] = fabsf(busVoltage[ch] * current[ch]);                                 // Milliwatts
+}
+
+// Reading MASK_ENABLE also releases this device's hold on the ALERT line.
+static bool conversion_ready(int ch) {
+  uint16_t flags;
+  return read_register(CHANNEL_ADDRESS[ch], INA226_REG_MASK_ENABLE, flags) && (flags & INA226_MASK_CVRF);
+}
+
+// A wake interrupt like the PIR's: light sleep would drop a FALLING edge, and
+// the latched line would then stay low and never produce another one.
+static void IRAM_ATTR handle_ina226_alert() {
+  int level = digitalRead(INA226_ALERT_PIN);
+  rearm_wake_interrupt(INA226_ALERT_PIN, level);
+  if (level == LOW) alertPending = true;
+}
+
+static void setup_channel(INA226* ina, int ch) {
+  ina->begin(CHANNEL_ADDRESS[ch]);
+  ina226_averages_t averages = INA226_USE_ALERT_PIN ? INA226_ALERT_AVERAGES : INA226_AVERAGES_16;
+  ina->configure(averages, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
+  ina->calibrate(CHANNEL_SHUNT[ch], 10);
+  if (INA226_USE_ALERT_PIN) {
+    ina->enableConversionReadyAlert();
+    ina->setAlertLatch(true); // Hold ALERT until MASK_ENABLE is read so no conversion is missed
+  }
+}
+
 void setup_power_monitor() {
   Serial.println("Initializing INA226 Sensor...");
 
@@ -29,82 +249,111 @@ void setup_power_monitor() {
   
   // Initialize and calibrate our first sensor
   ina_ch1 = new INA226();
-  ina_ch1->begin(INA226_CH1_ADDRESS);
-  ina_ch1->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-  ina_ch1->calibrate(INA226_CH1_SHUNT, 10);
+  setup_channel(ina_ch1, 0);
   Serial.println("INA226 Channel 1 (Solar Panel) Initialized.");
 
 //  ina_ch2 = new INA226();
-//  ina_ch2->begin(INA226_CH2_ADDRESS);
-//  ina_ch2->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-//  ina_ch2->calibrate(INA226_CH2_SHUNT, 10);
+//  setup_channel(ina_ch2, 1);
 //  Serial.println("INA226 Channel 2 (Battery) Initialized.");
 
   ina_ch3 = new INA226();
-  ina_ch3->begin(INA226_CH3_ADDRESS);
-  ina_ch3->configure(INA226_AVERAGES_16, INA226_BUS_CONV_TIME_1100US, INA226_SHUNT_CONV_TIME_1100US, INA226_MODE_SHUNT_BUS_CONT);
-  ina_ch3->calibrate(INA226_CH3_SHUNT, 10);
+  setup_channel(ina_ch3, 2);
   Serial.println("INA226 Channel 3 (Load) Initialized.");
+
+  if (INA226_USE_ALERT_PIN) {
+    pinMode(INA226_ALERT_PIN, INPUT_PULLUP);
+    attach_wake_interrupt(INA226_ALERT_PIN, handle_ina226_alert);
+    // A conversion may have completed before the interrupt was attached
+    alertPending = true;
+    for (int ch = 0; ch < 3; ch++) channelReadTime[ch] = millis() - INA226_CONVERSION_MS;
+  }
+}
+
+// Samples every fitted channel that is due and whose conversion has
+// completed. Returns true if at least one channel was read.
+static bool sample_on_alert() {
+  // The level is checked as well, in case the interrupt was missed anyway
+  if (!alertPending && digitalRead(INA226_ALERT_PIN) != LOW) return false;
+  alertPending = false;
+
+  unsigned long now = millis();
+  bool sampled = false;
+  for (int ch = 0; ch < 3; ch++) {
+    if (!CHANNEL_FITTED[ch] || now - channelReadTime[ch] < INA226_CONVERSION_DUE_MS) continue;
+    if (conversion_ready(ch)) {
+      read_channel(ch);
+      channelReadTime[ch] = now;
+      sampled = true;
+    }
+  }
+  // Another device may have finished while we were reading; the shared line
+  // then stays low and no new falling edge arrives.
+  if (digitalRead(INA226_ALERT_PIN) == LOW) alertPending = true;
+  return sampled;
+}
+
+static bool sample_on_timer() {
+  if (millis() - lastSensorReadTime <= SENSOR_READ_INTERVAL) return false;
+  lastSensorReadTime = millis();
+
+  for (int ch = 0; ch < 3; ch++) {
+    if (CHANNEL_FITTED[ch]) read_channel(ch);
+  }
+  return true;
 }
 
 void loop_power_monitor() {
-  if (millis() - lastSensorReadTime > SENSOR_READ_INTERVAL) {
-    lastSensorReadTime = millis();
-    
-    // --- Read from Channel 1 ---
-    busVoltage[0] = ina_ch1->readBusVoltage();
-    current[0] = ina_ch1->readShuntCurrent() * 1000; // Convert Amps to Milliamps
-    power[0] = ina_ch1->readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-
-    JsonDocument powerCh1Payload;
-    powerCh1Payload["bus_voltage"] = busVoltage[0];
-    powerCh1Payload["current"] = current[0];
-    powerCh1Payload["power"] = power[0];
-    char buffer1[128];
-    serializeJson(powerCh1Payload, buffer1);
-    client.publish(MQTT_TOPIC_POWER_CH1_STATE, buffer1, true);
-
-    // --- Read from Channel 2 ---
-//    busVoltage[1] = ina_ch2->readBusVoltage();
-//    current[1] = ina_ch2->readShuntCurrent() * 1000; // Convert Amps to Milliamps
-//    power[1] = ina_ch2->readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-
-//    JsonDocument powerCh2Payload;
-//    powerCh2Payload["bus_voltage"] = busVoltage[1];
-//    powerCh2Payload["current"] = current[1];
-//    powerCh2Payload["power"] = power[1];
-//    char buffer2[128];
-//    serializeJson(powerCh2Payload, buffer2);
-//    client.publish(MQTT_TOPIC_POWER_CH2_STATE, buffer2, true);
-
-    // --- Read from Channel 3 ---
-    busVoltage[2] = ina_ch3->readBusVoltage();
-    current[2] = ina_ch3->readShuntCurrent() * 1000; // Convert Amps to Milliamps
-    power[2] = ina_ch3->readBusPower() * 1000;       // Convert Watts to Milliwatts ---
-
-    JsonDocument powerCh3Payload;
-    powerCh3Payload["bus_voltage"] = busVoltage[2];
-    powerCh3Payload["current"] = current[2];
-    powerCh3Payload["power"] = power[2];
-    char buffer3[128];
-    serializeJson(powerCh3Payload, buffer3);
-    client.publish(MQTT_TOPIC_POWER_CH3_STATE, buffer3, true);
+  bool sampled = INA226_USE_ALERT_PIN ? sample_on_alert() : sample_on_timer();
+  if (!sampled) return;
+
+  PowerReadings readings;
+  memcpy(readings.busVoltage, busVoltage, sizeof(readings.busVoltage));
+  memcpy(readings.current, current, sizeof(readings.current));
+  memcpy(readings.power, power, sizeof(readings.power));
+  readingsSnapshot.publish(readings);
+
+  history_record_sample(busVoltage, current, power);
+  energy_record_sample(power, current);
+  if (power_channel_fitted(POWER_BATTERY_CHANNEL)) {
+    battery_record_sample(busVoltage[POWER_BATTERY_CHANNEL - 1], current[POWER_BATTERY_CHANNEL - 1]);
   }
 }
 
+void loop_power_publisher() {
+  uint32_t version = readingsSnapshot.version();
+  if (version == lastCheckedVersion) return;
+  lastCheckedVersion = version;
+
+  PowerReadings readings = readingsSnapshot.read();
+  if (POWER_TELEMETRY_MODE != POWER_TELEMETRY_PER_CHANNEL) {
+    publish_batch_if_changed(readings);
+    return;
+  }
+  for (int ch = 0; ch < 3; ch++) {
+    if (CHANNEL_FITTED[ch]) publish_channel_if_changed(ch, CHANNEL_TOPIC[ch], readings);
+  }
+}
+
+PowerReadings get_power_readings() {
+  return readingsSnapshot.read();
+}
+
+bool power_channel_fitted(int channel) {
+  return channel >= 1 && channel <= 3 && CHANNEL_FITTED[channel - 1];
+}
+
 // --- Data Getter Functions ---
 float get_bus_voltage(int channel) {
-  if (channel >= 1 && channel <= 3) return busVoltage[channel - 1];
+  if (channel >= 1 && channel <= 3) return get_power_readings().busVoltage[channel - 1];
   return 0.0;
 }
 
 float get_current(int channel) {
-  if (channel >= 1 && channel <= 3) return current[channel - 1];
+  if (channel >= 1 && channel <= 3) return get_power_readings().current[channel - 1];
   return 0.0;
 }
 
 float get_power(int channel) {
-  if (channel >= 1 && channel <= 3) return power[channel - 1];
+  if (channel >= 1 && channel <= 3) return get_power_readings().power[channel - 1];
   return 0.0;
 }
-
@@ -0,0 +1,77 @@
+#include <Arduino.h>
+#include <atomic>
+#include <Preferences.h>
+#include "settings.h"
+#include "config.h"
+
+// --- Setting Table ---
+// NVS keys are limited to 15 characters.
+struct SettingDescriptor {
+  const char* key;
+  uint32_t defaultValue;
+  uint32_t min;
+  uint32_t max;
+};
+
+static const SettingDescriptor SETTINGS[SETTING_COUNT] = {
+  {"motion_ms", 10000, 10000, 3600000},   // 10 s, 10 s to 1 h
+  {"manual_ms", 300000, 10000, 3600000},  // 5 min, 10 s to 1 h
+};
+
+// --- RAM Cache ---
+// Written by whichever task changes a setting (the control task) and flushed
+// by the sensor task. A change sets its dirty bit after storing the value, and
+// the flush clears the bits before reading the values, so a change that lands
+// mid-flush is simply written on the next one.
+static std::atomic<uint32_t> values[SETTING_COUNT];
+static std::atomic<uint32_t> dirtyMask{0};
+static std::atomic<unsigned long> lastChangeTime{0};
+
+static uint32_t storedValues[SETTING_COUNT];  // What NVS holds (sensor task)
+static Preferences settingsPrefs;
+
+static bool in_range(SettingId id, uint32_t value) {
+  return value >= SETTINGS[id].min && value <= SETTINGS[id].max;
+}
+
+void setup_settings() {
+  settingsPrefs.begin("settings", false);
+  for (int i = 0; i < SETTING_COUNT; i++) {
+    uint32_t value = settingsPrefs.getUInt(SETTINGS[i].key, SETTINGS[i].defaultValue);
+    if (!in_range((SettingId)i, value)) value = SETTINGS[i].defaultValue;
+    values[i].store(value, std::memory_order_relaxed);
+    storedValues[i] = value;
+  }
+  Serial.println("Settings loaded from NVS.");
+}
+
+uint32_t get_setting(SettingId id) {
+  return values[id].load(std::memory_order_relaxed);
+}
+
+bool set_setting(SettingId id, uint32_t value) {
+  if (!in_range(id, value)) return false;
+  values[id].store(value, std::memory_order_relaxed);
+  lastChangeTime.store(millis(), std::memory_order_relaxed);
+  dirtyMask.fetch_or(1u << id, std::memory_order_release);
+  return true;
+}
+
+void loop_settings() {
+  if (dirtyMask.load(std::memory_order_acquire) == 0) return;
+  if (millis() - lastChangeTime.load(std::memory_order_relaxed) < SETTINGS_WRITE_DELAY) return;
+
+  uint32_t dirty = dirtyMask.exchange(0, std::memory_order_acquire);
+  for (int i = 0; i < SETTING_COUNT; i++) {
+    if (!(dirty & (1u << i))) continue;
+    uint32_t value = values[i].load(std::memory_order_relaxed);
+    // Edits that ended where they started cost nothing
+    if (value == storedValues[i]) continue;
+    if (settingsPrefs.putUInt(SETTINGS[i].key, value) == sizeof(value)) {
+      storedValues[i] = value;
+    } else {
+      dirtyMask.fetch_or(1u << i, std::memory_order_relaxed);  // Retry after the next delay
+      lastChangeTime.store(millis(), std::memory_order_relaxed);
+    }
+  }
+}
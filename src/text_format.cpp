@@ -0,0 +1,91 @@
+#include <math.h>
+#include "text_format.h"
+
+static const uint32_t POWERS_OF_TEN[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+static const uint8_t MAX_DECIMALS = 6;
+
+TextBuffer::TextBuffer(char* buffer, size_t size)
+    : buffer(buffer), size(size), used(0), truncated(false) {
+  if (size > 0) buffer[0] = '\0';
+}
+
+TextBuffer& TextBuffer::append(char c) {
+  if (used + 1 < size) {
+    buffer[used++] = c;
+    buffer[used] = '\0';
+  } else {
+    truncated = true;
+  }
+  return *this;
+}
+
+TextBuffer& TextBuffer::append(const char* text) {
+  while (*text) append(*text++);
+  return *this;
+}
+
+// Digits are produced least significant first, then copied out in order
+static void append_digits(TextBuffer& out, uint64_t value, uint8_t minDigits) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = '0' + (value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (count < minDigits) digits[count++] = '0';
+  while (count > 0) out.append(digits[--count]);
+}
+
+TextBuffer& TextBuffer::append_unsigned(uint32_t value) {
+  append_digits(*this, value, 1);
+  return *this;
+}
+
+TextBuffer& TextBuffer::append_signed(int32_t value) {
+  if (value < 0) append('-');
+  // Negate in 64 bits so INT32_MIN survives
+  append_digits(*this, value < 0 ? -(int64_t)value : value, 1);
+  return *this;
+}
+
+TextBuffer& TextBuffer::append_fixed(float value, uint8_t decimals) {
+  // JSON has no NaN or infinity, and these values go into MQTT payloads
+  if (!isfinite(value)) return append("null");
+  if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+
+  // Round once in fixed point, then split into whole and fractional parts
+  uint32_t scale = POWERS_OF_TEN[decimals];
+  int64_t scaled = llroundf(value * scale);
+  if (scaled < 0) {
+    append('-');
+    scaled = -scaled;
+  }
+  append_digits(*this, scaled / scale, 1);
+  if (decimals > 0) {
+    append('.');
+    append_digits(*this, scaled % scale, decimals);
+  }
+  return *this;
+}
+
+TextBuffer& TextBuffer::append_duration(unsigned long milliseconds) {
+  unsigned long totalSeconds = milliseconds / 1000;
+  append_digits(*this, totalSeconds / 3600, 2);
+  append(':');
+  append_digits(*this, (totalSeconds / 60) % 60, 2);
+  append(':');
+  append_digits(*this, totalSeconds % 60, 2);
+  return *this;
+}
+
+size_t format_unsigned(char* text, size_t size, uint32_t value) {
+  return TextBuffer(text, size).append_unsigned(value).length();
+}
+
+size_t format_fixed(char* text, size_t size, float value, uint8_t decimals) {
+  return TextBuffer(text, size).append_fixed(value, decimals).length();
+}
+
+size_t format_duration(char (&text)[DURATION_TEXT_SIZE], unsigned long milliseconds) {
+  return TextBuffer(text, DURATION_TEXT_SIZE).append_duration(milliseconds).length();
+}
@@ -0,0 +1,359 @@
+#include <Arduino.h>
+#include "user_interface.h"
+#include "display_manager.h"
+#include "encoder.h"
+#include "light_control.h"
+#include "power_monitor.h"
+#include "battery_soc.h"
+#include "loop_profiler.h"
+#include "config.h"
+
+// --- Screen Graph ---
+// Every screen is one row of SCREENS: how to draw it, what the knob and a
+// click do on it, when it needs a redraw, and where a double click leads.
+// Adding a screen means adding an id and a row.
+enum ScreenId {
+  SCREEN_POWER_ALL,
+  SCREEN_POWER_CH1,
+  SCREEN_POWER_CH2,
+  SCREEN_POWER_CH3,
+  SCREEN_LIGHTS,
+  SCREEN_LIGHTS_MENU,
+  SCREEN_EDIT_MOTION_TIMER,
+  SCREEN_EDIT_MANUAL_TIMER,
+  SCREEN_TREND_CH1,
+  SCREEN_TREND_CH2,
+  SCREEN_TREND_CH3,
+  SCREEN_DIAGNOSTICS,
+  SCREEN_COUNT
+};
+
+struct ScreenInput {
+  int turn;             // Detents since the last pass
+  int acceleratedTurn;  // The same, scaled up on fast spins
+  bool click;
+};
+
+struct Screen {
+  void (*render)(int param, const DisplayData& data);
+  // nullptr: the screen ignores input. Top-level screens get clicks only;
+  // the knob steps between them.
+  void (*input)(int param, const ScreenInput& input, const LightState& light);
+  // nullptr: redraw every frame. Otherwise only when this says the data on
+  // screen is stale (input and screen changes always redraw).
+  bool (*dirty)(const DisplayData& now, const DisplayData& drawn);
+  int param;            // Passed to render and input, e.g. the channel
+  ScreenId back;        // Double click target
+  bool topLevel;
+  bool countdown;       // Keeps the full frame rate while the light is on
+  bool holdSteps;       // Long press and hold-repeat step the value instead of toggling the light
+};
+
+// --- State Tracking Variables (UI task only) ---
+static ScreenId currentScreen = SCREEN_POWER_ALL;
+static bool redrawPending = true;
+static DisplayData drawnData;  // What the current screen was last drawn from
+
+static int lightsMenuSelection = 0;
+static const int LIGHTS_MENU_ITEM_COUNT = 3;
+
+// --- Temporary variables for editing timers ---
+static unsigned long tempMotionTimerDuration;
+static unsigned long tempManualTimerDuration;
+
+static int lastEncoderValue = 0;
+static int lastAcceleratedValue = 0;
+static int holdDirection = 1;  // Way a held button steps: that of the last turn
+
+// Timer edits move in 30 s detents, scaled up by the encoder on fast spins
+static const long TIMER_EDIT_STEP = 30000;
+static const long TIMER_EDIT_MIN = 10000;
+static const long TIMER_EDIT_MAX = 3600000;
+
+// --- Non-Blocking Timers ---
+static unsigned long lastDisplayUpdateTime = 0;
+static unsigned long lastUserActivityTime = 0;  // Last encoder, button or PIR activity
+
+static DisplayPower displayPower = DISPLAY_AWAKE;
+
+static void show_screen(ScreenId screen) {
+  if (screen != currentScreen) {
+    currentScreen = screen;
+    display_screen_changed();
+  }
+  redrawPending = true;
+}
+
+// --- Renderers ---
+static void render_power_all(int, const DisplayData& data) { draw_power_all_screen(data); }
+static void render_power_channel(int channel, const DisplayData& data) { draw_power_channel_screen(channel, data); }
+static void render_power_trend(int channel, const DisplayData& data) { draw_power_trend_screen(channel, data); }
+static void render_lights(int, const DisplayData& data) { draw_lights_live_screen(data); }
+static void render_lights_menu(int, const DisplayData& data) { draw_lights_menu_screen(data); }
+static void render_edit_timer(int isMotion, const DisplayData& data) { draw_edit_timer_screen(data, isMotion); }
+static void render_diagnostics(int, const DisplayData&) { draw_diagnostics_screen(); }
+
+// --- Dirty Checks ---
+// Compared as drawn (10 mV, 1 mA, 1 mW), so ADC noise below the last shown
+// digit does not redraw and flush the screen on every sample
+static bool reading_changed(float now, float drawn, float scale) {
+  return lroundf(now * scale) != lroundf(drawn * scale);
+}
+
+static bool power_changed(const DisplayData& now, const DisplayData& drawn) {
+  for (int i = 0; i < 3; i++) {
+    if (reading_changed(now.busVoltage[i], drawn.busVoltage[i], 100.0f) ||
+        reading_changed(now.current[i], drawn.current[i], 1.0f) ||
+        reading_changed(now.power[i], drawn.power[i], 1.0f)) {
+      return true;
+    }
+  }
+  return now.battery.valid != drawn.battery.valid ||
+         now.battery.socPermille != drawn.battery.socPermille ||
+         now.battery.minutesToEmpty != drawn.battery.minutesToEmpty ||
+         now.battery.minutesToFull != drawn.battery.minutesToFull;
+}
+
+static bool light_state_changed(const DisplayData& now, const DisplayData& drawn) {
+  return now.lightIsOn != drawn.lightIsOn;  // "Turn On" / "Turn Off"
+}
+
+static bool never_changes(const DisplayData&, const DisplayData&) {
+  return false;
+}
+
+// --- Input Handlers ---
+static void power_all_input(int, const ScreenInput& input, const LightState&) {
+  // Hidden diagnostics screen behind the overview
+  if (input.click) show_screen(SCREEN_DIAGNOSTICS);
+}
+
+static void power_channel_input(int channel, const ScreenInput& input, const LightState&) {
+  if (input.click) show_screen((ScreenId)(SCREEN_TREND_CH1 + channel - 1));
+}
+
+static void power_trend_input(int channel, const ScreenInput& input, const LightState&) {
+  if (input.click) show_screen((ScreenId)(SCREEN_POWER_CH1 + channel - 1));
+}
+
+static void diagnostics_input(int, const ScreenInput& input, const LightState&) {
+  if (input.click) show_screen(SCREEN_POWER_ALL);
+}
+
+static void lights_input(int, const ScreenInput& input, const LightState&) {
+  if (input.click) {
+    lightsMenuSelection = 0;
+    show_screen(SCREEN_LIGHTS_MENU);
+  }
+}
+
+static void lights_menu_input(int, const ScreenInput& input, const LightState& light) {
+  if (input.turn != 0) {
+    lightsMenuSelection += (input.turn > 0) ? 1 : -1;
+    if (lightsMenuSelection < 0) lightsMenuSelection = LIGHTS_MENU_ITEM_COUNT - 1;
+    if (lightsMenuSelection >= LIGHTS_MENU_ITEM_COUNT) lightsMenuSelection = 0;
+  }
+  if (input.click) {
+    switch (lightsMenuSelection) {
+      case 0:
+        send_light_command_from_ui({light.lightIsOn ? LIGHT_CMD_OFF : LIGHT_CMD_ON, 0});
+        break;
+      case 1:
+        tempMotionTimerDuration = light.motionTimerDuration;
+        show_screen(SCREEN_EDIT_MOTION_TIMER);
+        break;
+      case 2:
+        tempManualTimerDuration = light.manualTimerDuration;
+        show_screen(SCREEN_EDIT_MANUAL_TIMER);
+        break;
+    }
+  }
+}
+
+static unsigned long adjust_timer(unsigned long duration, int steps) {
+  long value = (long)duration + steps * TIMER_EDIT_STEP;
+  return constrain(value, TIMER_EDIT_MIN, TIMER_EDIT_MAX);
+}
+
+static void edit_timer_input(int isMotion, const ScreenInput& input, const LightState&) {
+  unsigned long& duration = isMotion ? tempMotionTimerDuration : tempManualTimerDuration;
+  duration = adjust_timer(duration, input.acceleratedTurn);
+  if (input.click) {
+    send_light_command_from_ui({isMotion ? LIGHT_CMD_SET_MOTION_TIMER : LIGHT_CMD_SET_MANUAL_TIMER, duration});
+    show_screen(SCREEN_LIGHTS_MENU);
+  }
+}
+
+static const Screen SCREENS[SCREEN_COUNT] = {
+  // render, input, dirty, param, back, topLevel, countdown, holdSteps
+  {render_power_all, power_all_input, power_changed, 0, SCREEN_POWER_ALL, true, false, false},
+  {render_power_channel, power_channel_input, power_changed, 1, SCREEN_POWER_ALL, true, false, false},
+  {render_power_channel, power_channel_input, power_changed, 2, SCREEN_POWER_ALL, true, false, false},
+  {render_power_channel, power_channel_input, power_changed, 3, SCREEN_POWER_ALL, true, false, false},
+  {render_lights, lights_input, nullptr, 0, SCREEN_POWER_ALL, true, true, false},
+  {render_lights_menu, lights_menu_input, light_state_changed, 0, SCREEN_LIGHTS, false, false, false},
+  {render_edit_timer, edit_timer_input, never_changes, true, SCREEN_LIGHTS_MENU, false, false, true},
+  {render_edit_timer, edit_timer_input, never_changes, false, SCREEN_LIGHTS_MENU, false, false, true},
+  {render_power_trend, power_trend_input, nullptr, 1, SCREEN_POWER_CH1, false, false, false},
+  {render_power_trend, power_trend_input, nullptr, 2, SCREEN_POWER_CH2, false, false, false},
+  {render_power_trend, power_trend_input, nullptr, 3, SCREEN_POWER_CH3, false, false, false},
+  {render_diagnostics, diagnostics_input, nullptr, 0, SCREEN_POWER_ALL, false, false, false},
+};
+
+// The knob on a top-level screen steps to the next top-level screen
+static void step_top_level(int turn) {
+  int screen = currentScreen;
+  do {
+    screen = (screen + (turn > 0 ? 1 : -1) + SCREEN_COUNT) % SCREEN_COUNT;
+  } while (!SCREENS[screen].topLevel);
+  show_screen((ScreenId)screen);
+}
+
+static void dispatch_input(const ScreenInput& input, const LightState& light) {
+  const Screen& screen = SCREENS[currentScreen];
+  if (screen.topLevel && input.turn != 0) {
+    step_top_level(input.turn);
+    return;
+  }
+  if (screen.input) screen.input(screen.param, input, light);
+  redrawPending = true;
+}
+
+// One step in the direction the knob last turned, as if it had turned again
+static void dispatch_hold_step(const LightState& light) {
+  ScreenInput step = {0, holdDirection, false};
+  dispatch_input(step, light);
+}
+
+// --- Central Input Dispatcher ---
+// While the panel is off the first input only wakes it, so nobody fumbling for
+// the knob in the dark toggles the light by accident.
+static void handle_input(const LightState& light) {
+  bool asleep = (displayPower == DISPLAY_ASLEEP);
+  ScreenInput input = {0, 0, false};
+  // Both counters are consumed together, so the accelerated steps always go
+  // out with the detents they belong to
+  EncoderPosition position = get_encoder_position();
+  if (position.value != lastEncoderValue) {
+    input.turn = position.value - lastEncoderValue;
+    input.acceleratedTurn = position.accelerated - lastAcceleratedValue;
+    lastEncoderValue = position.value;
+    lastAcceleratedValue = position.accelerated;
+    lastUserActivityTime = millis();
+    holdDirection = (input.turn > 0) ? 1 : -1;
+  }
+
+  if (input.turn != 0 && !asleep) dispatch_input(input, light);
+
+  // --- Button Gestures ---
+  // Click goes to the screen, double click follows its back link, and a long
+  // press toggles the light from any screen except those that step a value
+  // while the button is held.
+  ButtonEvent event;
+  while (get_button_event(event)) {
+    lastUserActivityTime = millis();
+    if (asleep) continue;
+    switch (event.type) {
+      case BUTTON_CLICK: {
+        ScreenInput click = {0, 0, true};
+        dispatch_input(click, light);
+        break;
+      }
+      case BUTTON_DOUBLE_CLICK:
+        show_screen(SCREENS[currentScreen].back);
+        break;
+      case BUTTON_LONG_PRESS:
+        if (SCREENS[currentScreen].holdSteps) dispatch_hold_step(light);
+        else send_light_command_from_ui({light.lightIsOn ? LIGHT_CMD_OFF : LIGHT_CMD_ON, 0});
+        break;
+      case BUTTON_HOLD_REPEAT:
+        if (SCREENS[currentScreen].holdSteps) dispatch_hold_step(light);
+        break;
+    }
+  }
+}
+
+// --- Panel Power Scheduling ---
+// Dims, then switches the panel off, once nobody has moved or touched anything
+// for a while; any motion or input turns it straight back on.
+static void update_display_power() {
+  unsigned long idle = millis() - lastUserActivityTime;
+  DisplayPower wanted = DISPLAY_AWAKE;
+  if (idle > DISPLAY_SLEEP_TIMEOUT) wanted = DISPLAY_ASLEEP;
+  else if (idle > DISPLAY_DIM_TIMEOUT) wanted = DISPLAY_DIMMED;
+  if (wanted == displayPower) return;
+
+  // Waking up: the panel shows whatever it had when it went off
+  if (displayPower == DISPLAY_ASLEEP) redrawPending = true;
+  displayPower = wanted;
+  set_display_power(wanted);
+}
+
+void setup_user_interface() {
+  lastUserActivityTime = millis();
+  EncoderPosition position = get_encoder_position();
+  lastEncoderValue = position.value;
+  lastAcceleratedValue = position.accelerated;
+}
+
+void loop_user_interface() {
+  uint32_t stageStart = profile_start();
+  loop_encoder();
+  profile_end(PROFILE_ENCODER, stageStart);
+
+  LightState light = get_light_state();
+  // Someone moving in the shed keeps the screen on, as turning the knob does
+  if (light.motionDetected) {
+    lastUserActivityTime = millis();
+  }
+
+  bool userActive = (millis() - lastUserActivityTime <= INACTIVITY_TIMEOUT);
+  if (!userActive && currentScreen != SCREEN_POWER_ALL) {
+    show_screen(SCREEN_POWER_ALL);
+  }
+
+  // --- Central Input Handling ---
+  stageStart = profile_start();
+  handle_input(light);
+  profile_end(PROFILE_INPUT, stageStart);
+
+  update_display_power();
+  if (displayPower == DISPLAY_ASLEEP) return;
+
+  // --- Display Updates ---
+  // 10 Hz while someone is around or a countdown is running, 1 Hz otherwise.
+  // Either way a frame is only drawn if the screen's data changed.
+  const Screen& screen = SCREENS[currentScreen];
+  unsigned long frameInterval = DISPLAY_IDLE_UPDATE_INTERVAL;
+  if (userActive || (screen.countdown && light.lightIsOn)) frameInterval = DISPLAY_UPDATE_INTERVAL;
+
+  if (millis() - lastDisplayUpdateTime > frameInterval) {
+    lastDisplayUpdateTime = millis();
+
+    DisplayData data;
+    data.lightIsOn = light.lightIsOn;
+    data.lightManualOverride = light.lightManualOverride;
+    data.lightOnTime = light.lightOnTime;
+    data.lastMotionTime = light.lastMotionTime;
+    data.currentTimerDuration = light.lightManualOverride ? light.manualTimerDuration : light.motionTimerDuration;
+    data.lightsMenuSelection = lightsMenuSelection;
+    data.tempMotionTimerDuration = tempMotionTimerDuration;
+    data.tempManualTimerDuration = tempManualTimerDuration;
+    PowerReadings readings = get_power_readings();
+    for(int i=0; i<3; i++) {
+      data.busVoltage[i] = readings.busVoltage[i];
+      data.current[i] = readings.current[i];
+      data.power[i] = readings.power[i];
+    }
+    data.battery = get_battery_state();
+
+    // Static screens are left alone until something on them changes
+    if (redrawPending || screen.dirty == nullptr || screen.dirty(data, drawnData)) {
+      stageStart = profile_start();
+      screen.render(screen.param, data);
+      profile_end(PROFILE_DISPLAY, stageStart);
+      drawnData = data;
+      redrawPending = false;
+    }
+  }
+}
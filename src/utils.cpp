@@ -1,22 +1,45 @@
 #include "utils.h"
-#include "config.h" // Needed for the timer duration constants
+#include "settings.h"
+#include "config.h"
+#include <limits.h>
 
-String formatDuration(unsigned long milliseconds) {
-    unsigned long totalSeconds = milliseconds / 1000;
-    int seconds = totalSeconds % 60;
-    int minutes = (totalSeconds / 60) % 60;
-    int hours = (totalSeconds / 3600);
-    String formattedString = "";
-    if (hours < 10) formattedString += "0";
-    formattedString += String(hours) + ":";
-    if (minutes < 10) formattedString += "0";
-    formattedString += String(minutes) + ":";
-    if (seconds < 10) formattedString += "0";
-    formattedString += String(seconds);
-    return formattedString;
+uint32_t hash_topic(const char* data, size_t length) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+bool payload_equals(const char* payload, size_t length, const char* text) {
+  return strlen(text) == length && memcmp(payload, text, length) == 0;
+}
+
+bool parse_unsigned(const char* payload, size_t length, unsigned long& value) {
+  size_t i = 0;
+  while (i < length && payload[i] == ' ') i++;
+
+  unsigned long result = 0;
+  size_t digits = 0;
+  for (; i < length && payload[i] >= '0' && payload[i] <= '9'; i++, digits++) {
+    unsigned long digit = payload[i] - '0';
+    if (result > (ULONG_MAX - digit) / 10) return false;
+    result = result * 10 + digit;
+  }
+  if (digits == 0) return false;
+
+  if (i < length && payload[i] == '.') {
+    for (i++; i < length && payload[i] >= '0' && payload[i] <= '9'; i++) {}
+  }
+  while (i < length && payload[i] == ' ') i++;
+  if (i != length) return false;
+
+  value = result;
+  return true;
 }
 
 unsigned long get_current_timer_duration(bool isManualOverride) {
   // This function is now the single source of truth for timer logic.
-  return isManualOverride ? MANUAL_TIMER_DURATION : MOTION_TIMER_DURATION;
+  return get_setting(isManualOverride ? SETTING_MANUAL_TIMER : SETTING_MOTION_TIMER);
 }
\ No newline at end of file
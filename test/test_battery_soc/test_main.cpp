@@ -0,0 +1,104 @@
+// State-of-charge estimation (battery_soc.cpp) with the default lead-acid
+// profile and a 100 Ah battery. The estimator keeps its state between tests,
+// so they run as one charge/discharge story.
+//
+//   pio test -e native -f test_battery_soc
+
+#include <unity.h>
+#include "battery_soc.h"
+#include "config.h"
+#include "hal_fake.h"
+
+// Feeds a constant reading every 250 ms, like the sensor task
+static void feed(float volts, float currentMa, unsigned long ms) {
+  for (unsigned long t = 0; t < ms; t += 250) {
+    battery_record_sample(volts, currentMa);
+    fake_clock_advance_ms(250);
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_nothing_known_before_the_first_sample() {
+  TEST_ASSERT_FALSE(get_battery_state().valid);
+}
+
+// The first reading is looked up on the curve as a best guess
+static void test_first_sample_guesses_from_voltage() {
+  battery_record_sample(12.10f, 0.0f);
+  BatteryState state = get_battery_state();
+  TEST_ASSERT_TRUE(state.valid);
+  TEST_ASSERT_FALSE(state.synced);
+  TEST_ASSERT_EQUAL_UINT32(500, state.socPermille);
+  TEST_ASSERT_EQUAL_UINT32(BATTERY_TIME_UNKNOWN, state.minutesToEmpty);
+  TEST_ASSERT_EQUAL_UINT32(BATTERY_TIME_UNKNOWN, state.minutesToFull);
+}
+
+// A trickle under BATTERY_REST_CURRENT_MA still counts as rest. 12.31 V lies
+// between the 12.24 V (60%) and 12.37 V (70%) points of the curve.
+static void test_rest_reading_syncs_to_curve() {
+  feed(12.31f, 50.0f, BATTERY_REST_TIME - 60000);
+  TEST_ASSERT_FALSE(get_battery_state().synced);  // Not rested long enough yet
+  feed(12.31f, 50.0f, 60000 + 500);
+  BatteryState state = get_battery_state();
+  TEST_ASSERT_TRUE(state.synced);
+  TEST_ASSERT_EQUAL_UINT32(653, state.socPermille);
+}
+
+// 10 A for half an hour takes 5 Ah out
+static void test_discharge_counts_down() {
+  feed(12.0f, -10000.0f, 1800000);
+  BatteryState state = get_battery_state();
+  TEST_ASSERT_UINT32_WITHIN(2, 603, state.socPermille);
+  TEST_ASSERT_UINT32_WITHIN(5, 60300, state.remainingMah);
+  TEST_ASSERT_INT_WITHIN(5, -10000, state.averageCurrentMa);
+  TEST_ASSERT_UINT32_WITHIN(1, 361, state.minutesToEmpty);
+  TEST_ASSERT_EQUAL_UINT32(BATTERY_TIME_UNKNOWN, state.minutesToFull);
+}
+
+// Only 90% of what goes into a lead-acid battery is stored
+static void test_charge_counts_up_with_efficiency() {
+  feed(13.0f, 10000.0f, 1800000);
+  BatteryState state = get_battery_state();
+  TEST_ASSERT_UINT32_WITHIN(2, 648, state.socPermille);
+  TEST_ASSERT_UINT32_WITHIN(5, 64800, state.remainingMah);
+  TEST_ASSERT_UINT32_WITHIN(1, 234, state.minutesToFull);
+  TEST_ASSERT_EQUAL_UINT32(BATTERY_TIME_UNKNOWN, state.minutesToEmpty);
+}
+
+// A charge that tapers to the tail current at full voltage has filled the
+// battery; the count's distance from 100% is recorded as its drift
+static void test_tail_current_anchors_full() {
+  feed(14.2f, 1000.0f, BATTERY_FULL_HOLD_TIME - 1000);
+  TEST_ASSERT_LESS_THAN(1000, get_battery_state().socPermille);
+  feed(14.2f, 1000.0f, 1500);
+  BatteryState state = get_battery_state();
+  TEST_ASSERT_EQUAL_UINT32(1000, state.socPermille);
+  TEST_ASSERT_EQUAL_UINT32(BATTERY_CAPACITY_MAH, state.remainingMah);
+  TEST_ASSERT_TRUE(state.synced);
+  TEST_ASSERT_INT_WITHIN(3, -352, state.lastFullDriftPermille);
+}
+
+// A large charge current at the same voltage is bulk charging, not the tail
+static void test_bulk_current_is_not_full() {
+  feed(12.0f, -10000.0f, 600000);
+  unsigned int before = get_battery_state().socPermille;
+  feed(14.2f, 10000.0f, BATTERY_FULL_HOLD_TIME * 2);
+  TEST_ASSERT_LESS_THAN(1000, get_battery_state().socPermille);
+  TEST_ASSERT_GREATER_THAN(before, get_battery_state().socPermille);
+}
+
+int main() {
+  setup_battery_soc();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_known_before_the_first_sample);
+  RUN_TEST(test_first_sample_guesses_from_voltage);
+  RUN_TEST(test_rest_reading_syncs_to_curve);
+  RUN_TEST(test_discharge_counts_down);
+  RUN_TEST(test_charge_counts_up_with_efficiency);
+  RUN_TEST(test_tail_current_anchors_full);
+  RUN_TEST(test_bulk_current_is_not_full);
+  return UNITY_END();
+}
@@ -0,0 +1,99 @@
+// MQTT command routing (mqtt_callback in connections.cpp): each command topic
+// reaches its handler through the hashed table, anything else is dropped.
+//
+//   pio test -e native -f test_command_router
+
+#include <string.h>
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "hal_fake.h"
+#include "light_control.h"
+#include "settings.h"
+
+// Delivers a message and lets the control task apply whatever it queued
+static void deliver(const char* topic, const char* payload) {
+  fake_mqtt_deliver(topic, payload);
+  loop_light_control();
+}
+
+static bool same_state(const LightState& a, const LightState& b) {
+  return a.lightIsOn == b.lightIsOn && a.lightManualOverride == b.lightManualOverride &&
+         a.motionTimerDuration == b.motionTimerDuration && a.manualTimerDuration == b.manualTimerDuration;
+}
+
+void setUp() {
+  fake_mqtt_reset_counters();
+}
+
+void tearDown() {}
+
+static void test_light_command() {
+  deliver(MQTT_TOPIC_LIGHT_COMMAND, "ON");
+  TEST_ASSERT_TRUE(get_light_state().lightIsOn);
+  TEST_ASSERT_TRUE(get_light_state().lightManualOverride);
+
+  deliver(MQTT_TOPIC_LIGHT_COMMAND, "OFF");
+  TEST_ASSERT_FALSE(get_light_state().lightManualOverride);
+}
+
+static void test_timer_commands() {
+  deliver(MQTT_TOPIC_LIGHT_MOTION_TIMER_SET, "120");
+  TEST_ASSERT_EQUAL_UINT32(120000, get_light_state().motionTimerDuration);
+
+  deliver(MQTT_TOPIC_LIGHT_MANUAL_TIMER_SET, "900");
+  TEST_ASSERT_EQUAL_UINT32(900000, get_light_state().manualTimerDuration);
+  TEST_ASSERT_EQUAL_UINT32(120000, get_light_state().motionTimerDuration);
+}
+
+static void test_history_query() {
+  deliver(MQTT_TOPIC_HISTORY_GET, "1 1m");
+  TEST_ASSERT_EQUAL_UINT32(1, fake_mqtt_publish_count());
+  TEST_ASSERT_NOT_NULL(fake_mqtt_last_payload(MQTT_TOPIC_HISTORY_STATE));
+}
+
+// Prefixes, extensions and a same-length neighbour of a command topic must
+// not reach its handler.
+static void test_unknown_topics_ignored() {
+  LightState before = get_light_state();
+  char neighbour[64];
+  strncpy(neighbour, MQTT_TOPIC_LIGHT_COMMAND, sizeof(neighbour) - 1);
+  neighbour[sizeof(neighbour) - 1] = '\0';
+  neighbour[strlen(neighbour) - 1] ^= 1;
+
+  deliver("shed/monitor/light", "ON");
+  deliver("shed/monitor/light/switch/extra", "ON");
+  deliver(neighbour, "ON");
+  deliver("shed/monitor/history/get/", "1");
+  deliver("", "ON");
+
+  TEST_ASSERT_TRUE(same_state(before, get_light_state()));
+  TEST_ASSERT_EQUAL_UINT32(0, fake_mqtt_publish_count());
+}
+
+static void test_invalid_payload_changes_nothing() {
+  LightState before = get_light_state();
+  deliver(MQTT_TOPIC_LIGHT_MOTION_TIMER_SET, "5");
+  deliver(MQTT_TOPIC_LIGHT_MANUAL_TIMER_SET, "soon");
+  deliver(MQTT_TOPIC_LIGHT_COMMAND, "on");
+  TEST_ASSERT_TRUE(same_state(before, get_light_state()));
+}
+
+int main() {
+  setup_settings();
+  setup_light_control();
+  setup_connections();
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+  client.setCallback(mqtt_callback);
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_light_command);
+  RUN_TEST(test_timer_commands);
+  RUN_TEST(test_history_query);
+  RUN_TEST(test_unknown_topics_ignored);
+  RUN_TEST(test_invalid_payload_changes_nothing);
+  return UNITY_END();
+}
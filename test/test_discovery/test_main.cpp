@@ -0,0 +1,143 @@
+// Home Assistant discovery documents (discovery.cpp) and the streamed publish
+// under them (publish_streamed in connections.cpp). The fake broker drops a
+// streamed message whose size differs from the length announced up front, so
+// a publish that arrives proves the measuring pass matched the bytes sent.
+//
+//   pio test -e native -f test_discovery
+
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "discovery.h"
+#include "hal_fake.h"
+#include "power_monitor.h"
+
+static const char* MAIN_TOPIC = "homeassistant/device/shed_esp32_c6_01/config";
+static const char* ENERGY_TOPIC = "homeassistant/device/shed_esp32_c6_01_energy/config";
+static const char* TEST_TOPIC = "test/streamed";
+
+// Minimal structural check: balanced braces and brackets outside strings,
+// no stray escapes, and the document is a single object.
+static bool well_formed_json(const char* text) {
+  if (text == nullptr || text[0] != '{') return false;
+  char stack[32];
+  int depth = 0;
+  bool inString = false;
+  for (const char* p = text; *p; p++) {
+    if (inString) {
+      if (*p == '\\') {
+        if (!*++p) return false;
+      } else if (*p == '"') {
+        inString = false;
+      }
+      continue;
+    }
+    if (*p == '"') {
+      inString = true;
+    } else if (*p == '{' || *p == '[') {
+      if (depth == (int)sizeof(stack)) return false;
+      stack[depth++] = *p == '{' ? '}' : ']';
+    } else if (*p == '}' || *p == ']') {
+      if (depth == 0 || stack[--depth] != *p) return false;
+      if (depth == 0 && p[1] != '\0') return false;
+    }
+  }
+  return depth == 0 && !inString;
+}
+
+static bool contains(const char* payload, const char* text) {
+  return payload != nullptr && strstr(payload, text) != nullptr;
+}
+
+static void render_fixed(Print& out) {
+  out.print("{\"value\":42}");
+}
+
+// Writes one byte more on the sending pass than on the measuring pass
+static int renderCalls = 0;
+static void render_unstable(Print& out) {
+  out.print(renderCalls++ == 0 ? "{\"value\":4}" : "{\"value\":42}");
+}
+
+void setUp() {
+  fake_mqtt_reset_counters();
+}
+
+void tearDown() {}
+
+static void test_streamed_publish_delivers_payload() {
+  TEST_ASSERT_TRUE(publish_streamed(TEST_TOPIC, render_fixed, false));
+  TEST_ASSERT_EQUAL_STRING("{\"value\":42}", fake_mqtt_last_payload(TEST_TOPIC));
+}
+
+static void test_streamed_length_mismatch_is_not_delivered() {
+  const char* before = fake_mqtt_last_payload(TEST_TOPIC);
+  renderCalls = 0;
+  TEST_ASSERT_FALSE(publish_streamed("test/unstable", render_unstable, false));
+  TEST_ASSERT_NULL(fake_mqtt_last_payload("test/unstable"));
+  TEST_ASSERT_EQUAL_STRING(before, fake_mqtt_last_payload(TEST_TOPIC));
+}
+
+static void test_both_documents_published() {
+  mqtt_discovery();
+  TEST_ASSERT_EQUAL_UINT32(2, fake_mqtt_publish_count());
+  TEST_ASSERT_TRUE(well_formed_json(fake_mqtt_last_payload(MAIN_TOPIC)));
+  TEST_ASSERT_TRUE(well_formed_json(fake_mqtt_last_payload(ENERGY_TOPIC)));
+}
+
+// The main document is far larger than the packet buffer; streaming is what
+// lets it through at all.
+static void test_main_document_exceeds_packet_buffer() {
+  mqtt_discovery();
+  const char* payload = fake_mqtt_last_payload(MAIN_TOPIC);
+  TEST_ASSERT_NOT_NULL(payload);
+  TEST_ASSERT_TRUE(strlen(payload) > MQTT_BUFFER_SIZE);
+}
+
+static void test_main_document_entities() {
+  mqtt_discovery();
+  const char* payload = fake_mqtt_last_payload(MAIN_TOPIC);
+  TEST_ASSERT_TRUE(contains(payload, "\"shed_monitor_light\":{"));
+  TEST_ASSERT_TRUE(contains(payload, "\"shed_monitor_motion\":{"));
+  TEST_ASSERT_TRUE(contains(payload, "\"shed_monitor_power_ch1_voltage\":{"));
+  TEST_ASSERT_TRUE(contains(payload, "\"shed_monitor_power_ch3_power\":{"));
+  TEST_ASSERT_TRUE(contains(payload, "\"shed_monitor_light_on_time_24h\":{"));
+}
+
+static void test_unfitted_channel_left_out() {
+  TEST_ASSERT_FALSE(power_channel_fitted(POWER_BATTERY_CHANNEL));
+  mqtt_discovery();
+  const char* mainDocument = fake_mqtt_last_payload(MAIN_TOPIC);
+  const char* energyDocument = fake_mqtt_last_payload(ENERGY_TOPIC);
+  TEST_ASSERT_FALSE(contains(mainDocument, "_ch2_"));
+  TEST_ASSERT_FALSE(contains(energyDocument, "_ch2_"));
+  TEST_ASSERT_FALSE(contains(mainDocument, "shed_monitor_battery_"));
+  TEST_ASSERT_TRUE(contains(energyDocument, "\"shed_monitor_power_ch1_wh_total\":{"));
+  TEST_ASSERT_TRUE(contains(energyDocument, "\"shed_monitor_power_ch3_ah_total\":{"));
+}
+
+static void test_discovery_output_is_stable() {
+  mqtt_discovery();
+  std::string first = fake_mqtt_last_payload(MAIN_TOPIC);
+  mqtt_discovery();
+  TEST_ASSERT_EQUAL_STRING(first.c_str(), fake_mqtt_last_payload(MAIN_TOPIC));
+}
+
+int main() {
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_streamed_publish_delivers_payload);
+  RUN_TEST(test_streamed_length_mismatch_is_not_delivered);
+  RUN_TEST(test_both_documents_published);
+  RUN_TEST(test_main_document_exceeds_packet_buffer);
+  RUN_TEST(test_main_document_entities);
+  RUN_TEST(test_unfitted_channel_left_out);
+  RUN_TEST(test_discovery_output_is_stable);
+  return UNITY_END();
+}
@@ -0,0 +1,133 @@
+// Quadrature decoding of the rotary encoder (encoder.cpp), driven through
+// the fake GPIO so every edge goes through the real ISR.
+//
+//   pio test -e native -f test_encoder
+
+#include <unity.h>
+#include "config.h"
+#include "encoder.h"
+#include "hal_fake.h"
+
+// Encoder states as CLK << 1 | DT; both pins high is the rest state
+static void move_to(uint8_t state) {
+  fake_gpio_set(ENCODER_CLK_PIN, (state >> 1) & 1);
+  fake_gpio_set(ENCODER_DT_PIN, state & 1);
+}
+
+static void turn(const uint8_t* states, int count) {
+  for (int i = 0; i < count; i++) {
+    move_to(states[i]);
+    fake_clock_advance_ms(100);  // Slow enough that acceleration stays at 1
+  }
+}
+
+static int startValue;
+
+void setUp() {
+  startValue = get_encoder_value();
+}
+
+void tearDown() {
+  move_to(0b11);
+}
+
+static void test_clockwise_detent() {
+  const uint8_t steps[] = {0b01, 0b00, 0b10, 0b11};
+  turn(steps, 4);
+  TEST_ASSERT_EQUAL_INT(startValue + 1, get_encoder_value());
+}
+
+static void test_counter_clockwise_detent() {
+  const uint8_t steps[] = {0b10, 0b00, 0b01, 0b11};
+  turn(steps, 4);
+  TEST_ASSERT_EQUAL_INT(startValue - 1, get_encoder_value());
+}
+
+static void test_half_step_and_back_is_no_detent() {
+  const uint8_t steps[] = {0b01, 0b11, 0b10, 0b11};
+  turn(steps, 4);
+  TEST_ASSERT_EQUAL_INT(startValue, get_encoder_value());
+}
+
+// Three quarter steps seen out of four still count as the detent
+static void test_missed_quarter_step_keeps_detent() {
+  const uint8_t steps[] = {0b01, 0b00, 0b11};
+  turn(steps, 3);
+  TEST_ASSERT_EQUAL_INT(startValue + 1, get_encoder_value());
+}
+
+// Both pins changing between two interrupts is a bounce, not a move
+static void jump_to(uint8_t state) {
+  noInterrupts();
+  fake_gpio_set(ENCODER_CLK_PIN, (state >> 1) & 1);
+  interrupts();
+  fake_gpio_set(ENCODER_DT_PIN, state & 1);
+  fake_clock_advance_ms(100);
+}
+
+static void test_double_jump_is_ignored() {
+  jump_to(0b00);
+  jump_to(0b11);
+  TEST_ASSERT_EQUAL_INT(startValue, get_encoder_value());
+}
+
+static void test_several_detents() {
+  const uint8_t steps[] = {0b01, 0b00, 0b10, 0b11};
+  for (int i = 0; i < 5; i++) turn(steps, 4);
+  TEST_ASSERT_EQUAL_INT(startValue + 5, get_encoder_value());
+}
+
+// A detent every 100 ms is slow: both counters move by one
+static void test_slow_turn_moves_both_counters() {
+  EncoderPosition before = get_encoder_position();
+  const uint8_t steps[] = {0b01, 0b00, 0b10, 0b11};
+  for (int i = 0; i < 3; i++) turn(steps, 4);
+  EncoderPosition after = get_encoder_position();
+  TEST_ASSERT_EQUAL_INT(3, after.value - before.value);
+  TEST_ASSERT_EQUAL_INT(3, after.accelerated - before.accelerated);
+}
+
+// A detent every 8 ms is worth ten after the first; reversing starts at one
+static void test_fast_spin_accelerates() {
+  const uint8_t clockwise[] = {0b01, 0b00, 0b10, 0b11};
+  const uint8_t counterClockwise[] = {0b10, 0b00, 0b01, 0b11};
+  fake_clock_advance_ms(1000);
+  EncoderPosition before = get_encoder_position();
+  for (int detent = 0; detent < 5; detent++) {
+    for (uint8_t state : clockwise) {
+      move_to(state);
+      fake_clock_advance_ms(2);
+    }
+  }
+  EncoderPosition after = get_encoder_position();
+  TEST_ASSERT_EQUAL_INT(5, after.value - before.value);
+  TEST_ASSERT_EQUAL_INT(1 + 4 * 10, after.accelerated - before.accelerated);
+
+  for (uint8_t state : counterClockwise) {
+    move_to(state);
+    fake_clock_advance_ms(2);
+  }
+  EncoderPosition reversed = get_encoder_position();
+  TEST_ASSERT_EQUAL_INT(-1, reversed.value - after.value);
+  TEST_ASSERT_EQUAL_INT(-1, reversed.accelerated - after.accelerated);
+  TEST_ASSERT_EQUAL_INT(reversed.value, get_encoder_value());
+}
+
+int main() {
+  // Pull-ups hold both pins high at rest
+  fake_gpio_set(ENCODER_CLK_PIN, HIGH);
+  fake_gpio_set(ENCODER_DT_PIN, HIGH);
+  fake_gpio_set(ENCODER_SW_PIN, HIGH);
+  setup_encoder();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_clockwise_detent);
+  RUN_TEST(test_counter_clockwise_detent);
+  RUN_TEST(test_half_step_and_back_is_no_detent);
+  RUN_TEST(test_missed_quarter_step_keeps_detent);
+  RUN_TEST(test_double_jump_is_ignored);
+  RUN_TEST(test_several_detents);
+  RUN_TEST(test_slow_turn_moves_both_counters);
+  RUN_TEST(test_fast_spin_accelerates);
+  return UNITY_END();
+}
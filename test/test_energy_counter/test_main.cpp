@@ -0,0 +1,108 @@
+// Trapezoidal energy and charge accumulation (energy_counter.cpp). The
+// counters persist across tests, so each one checks the change it makes to
+// the lifetime totals.
+//
+//   pio test -e native -f test_energy_counter
+
+#include <string.h>
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "energy_counter.h"
+#include "hal_fake.h"
+
+// Feeds one sample on channel 1, the other channels idle
+static void record(float powerMw, float currentMa) {
+  const float power[3] = {powerMw, 0.0f, 0.0f};
+  const float current[3] = {currentMa, 0.0f, 0.0f};
+  energy_record_sample(power, current);
+}
+
+// A constant reading for `ms`, sampled every 250 ms like the sensor task
+static void hold(float powerMw, float currentMa, unsigned long ms) {
+  record(powerMw, currentMa);
+  for (unsigned long t = 0; t < ms; t += 250) {
+    fake_clock_advance_ms(250);
+    record(powerMw, currentMa);
+  }
+}
+
+static float whIn, ahIn, whOut, ahOut;
+
+void setUp() {
+  whIn = get_energy_wh(1, ENERGY_LIFETIME, false);
+  ahIn = get_charge_ah(1, ENERGY_LIFETIME, false);
+  whOut = get_energy_wh(1, ENERGY_LIFETIME, true);
+  ahOut = get_charge_ah(1, ENERGY_LIFETIME, true);
+}
+
+void tearDown() {
+  record(0.0f, 0.0f);  // No time passes, so the next test starts from zero
+}
+
+static void test_constant_power_for_an_hour() {
+  hold(1000.0f, 100.0f, 3600000);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, whIn + 1.0f, get_energy_wh(1, ENERGY_LIFETIME, false));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, ahIn + 0.1f, get_charge_ah(1, ENERGY_LIFETIME, false));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, whOut, get_energy_wh(1, ENERGY_LIFETIME, true));
+}
+
+// A ramp is integrated as its trapezoid, not the rectangle of either end
+static void test_ramp_is_a_trapezoid() {
+  record(0.0f, 0.0f);
+  fake_clock_advance_ms(1000);
+  record(3600000.0f, 0.0f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, whIn + 0.5f, get_energy_wh(1, ENERGY_LIFETIME, false));
+}
+
+// The power register has no sign; the current's sign picks the counter
+static void test_negative_current_counts_as_discharge() {
+  hold(1000.0f, -100.0f, 3600000);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, whIn, get_energy_wh(1, ENERGY_LIFETIME, false));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, ahIn, get_charge_ah(1, ENERGY_LIFETIME, false));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, whOut + 1.0f, get_energy_wh(1, ENERGY_LIFETIME, true));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, ahOut + 0.1f, get_charge_ah(1, ENERGY_LIFETIME, true));
+}
+
+static void test_published_totals() {
+  fake_clock_advance_ms(ENERGY_PUBLISH_INTERVAL);
+  loop_energy_publisher();
+  const char* payload = fake_mqtt_last_payload(MQTT_TOPIC_ENERGY_CH1_STATE);
+  TEST_ASSERT_NOT_NULL(payload);
+  TEST_ASSERT_NOT_NULL(strstr(payload, "\"wh_total\":1.500,\"ah_total\":0.1000,"
+                                       "\"wh_out_total\":1.000,\"ah_out_total\":0.1000}"));
+  TEST_ASSERT_NULL(fake_mqtt_last_payload(MQTT_TOPIC_ENERGY_CH2_STATE));  // Not fitted
+}
+
+// Past about 16 kWh a float can no longer hold 1 mWh, so the payload has to
+// come from the integer counter
+static void test_large_totals_keep_milliwatt_hours() {
+  record(1000000000.0f, 0.0f);
+  fake_clock_advance_ms(72000);
+  record(1000000000.0f, 0.0f);  // 20 kWh
+  record(3600000.0f, 0.0f);
+  fake_clock_advance_ms(1);
+  record(3600000.0f, 0.0f);     // 1 mWh
+
+  fake_clock_advance_ms(ENERGY_PUBLISH_INTERVAL);
+  loop_energy_publisher();
+  const char* payload = fake_mqtt_last_payload(MQTT_TOPIC_ENERGY_CH1_STATE);
+  TEST_ASSERT_NOT_NULL(payload);
+  TEST_ASSERT_NOT_NULL(strstr(payload, "\"wh_total\":20001.501,"));
+}
+
+int main() {
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.setBufferSize(MQTT_BUFFER_SIZE);  // As setup() does
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+  setup_energy();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_constant_power_for_an_hour);
+  RUN_TEST(test_ramp_is_a_trapezoid);
+  RUN_TEST(test_negative_current_counts_as_discharge);
+  RUN_TEST(test_published_totals);
+  RUN_TEST(test_large_totals_keep_milliwatt_hours);
+  return UNITY_END();
+}
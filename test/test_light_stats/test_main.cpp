@@ -0,0 +1,141 @@
+// Relay and occupancy statistics (light_stats.cpp): hourly bucket rollover
+// out of the 24 h and 7 d windows, and catching up the hours the device was
+// off once SNTP sets the clock. The counters and the in-memory NVS carry over
+// between tests, so they run in order.
+//
+//   pio test -e native -f test_light_stats
+
+#include <unity.h>
+#include "config.h"
+#include "hal_fake.h"
+#include "light_stats.h"
+
+static const unsigned long MINUTE_MS = 60000UL;
+static const unsigned long HOUR_MS = 60 * MINUTE_MS;
+static const time_t START_EPOCH = 1750000000;
+
+// Runs the sensor task's pass once a minute for the given time
+static void run_minutes(unsigned long minutes) {
+  for (unsigned long m = 0; m < minutes; m++) {
+    fake_clock_advance_ms(MINUTE_MS);
+    loop_light_stats();
+  }
+}
+
+// Turns the relay on for motion for the given time, then off again
+static void light_on_for(unsigned long minutes, bool manual) {
+  light_stats_relay_changed(true, manual);
+  loop_light_stats();
+  run_minutes(minutes);
+  light_stats_relay_changed(false, false);
+  loop_light_stats();
+}
+
+// Runs long enough for a save, then restarts after the device was off for
+// offSeconds. SNTP only sets the clock a few seconds after boot.
+static void reboot_after(uint32_t offSeconds) {
+  run_minutes(LIGHT_STATS_SAVE_INTERVAL / MINUTE_MS);
+  time_t shutdown = time(nullptr);
+
+  fake_clock_set_micros(0);
+  fake_clock_set_epoch(0);
+  setup_light_stats();
+  loop_light_stats();
+  fake_clock_advance_ms(5000);
+  fake_clock_set_epoch(shutdown + offSeconds + 5);
+  loop_light_stats();
+}
+
+static uint32_t on_seconds(LightStatsWindow window) {
+  return get_light_stats().windows[window].relayOnSeconds;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_starts_empty() {
+  LightStatsSummary summary = get_light_stats();
+  for (const LightStatsWindowSummary& window : summary.windows) {
+    TEST_ASSERT_EQUAL_UINT32(0, window.relayOnSeconds);
+    TEST_ASSERT_EQUAL_UINT32(0, window.switchCount);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, summary.lifetimeSwitchCount);
+}
+
+static void test_on_time_and_occupancy() {
+  light_on_for(10, false);
+  light_on_for(5, true);
+  LightStatsSummary summary = get_light_stats();
+  TEST_ASSERT_EQUAL_UINT32(900, summary.windows[LIGHT_STATS_24H].relayOnSeconds);
+  TEST_ASSERT_EQUAL_UINT32(2, summary.windows[LIGHT_STATS_24H].switchCount);
+  TEST_ASSERT_EQUAL_UINT32(900, summary.windows[LIGHT_STATS_7D].relayOnSeconds);
+  TEST_ASSERT_EQUAL_UINT32(2, summary.lifetimeSwitchCount);
+  TEST_ASSERT_EQUAL_UINT32(900, summary.lifetimeOnSeconds);
+  // Only the 10 motion minutes count as occupied, out of 15 covered so far
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 66.7f, summary.windows[LIGHT_STATS_24H].occupancyPercent);
+}
+
+static void test_on_time_spanning_buckets() {
+  light_on_for(150, false);
+  TEST_ASSERT_EQUAL_UINT32(900 + 9000, on_seconds(LIGHT_STATS_24H));
+  TEST_ASSERT_EQUAL_UINT32(900 + 9000, on_seconds(LIGHT_STATS_7D));
+}
+
+static void test_hours_leave_the_24h_window() {
+  run_minutes(24 * 60 + 60);
+  TEST_ASSERT_EQUAL_UINT32(0, on_seconds(LIGHT_STATS_24H));
+  TEST_ASSERT_EQUAL_UINT32(0, get_light_stats().windows[LIGHT_STATS_24H].switchCount);
+  TEST_ASSERT_EQUAL_UINT32(9900, on_seconds(LIGHT_STATS_7D));
+  TEST_ASSERT_EQUAL_UINT32(3, get_light_stats().windows[LIGHT_STATS_7D].switchCount);
+}
+
+static void test_hours_leave_the_7d_window() {
+  run_minutes(6 * 24 * 60);
+  TEST_ASSERT_EQUAL_UINT32(0, on_seconds(LIGHT_STATS_7D));
+  TEST_ASSERT_EQUAL_UINT32(0, get_light_stats().windows[LIGHT_STATS_7D].switchCount);
+  TEST_ASSERT_EQUAL_UINT32(9900, get_light_stats().lifetimeOnSeconds);
+  TEST_ASSERT_EQUAL_UINT32(3, get_light_stats().lifetimeSwitchCount);
+}
+
+static void test_short_downtime_keeps_recent_hours() {
+  light_on_for(10, false);
+  reboot_after(3600);
+  TEST_ASSERT_EQUAL_UINT32(600, on_seconds(LIGHT_STATS_24H));
+  TEST_ASSERT_EQUAL_UINT32(600, on_seconds(LIGHT_STATS_7D));
+  TEST_ASSERT_EQUAL_UINT32(10500, get_light_stats().lifetimeOnSeconds);
+}
+
+// The hours the device was off are rolled past, not added to its uptime
+static void test_downtime_rolls_the_buckets() {
+  light_on_for(10, false);
+  reboot_after(30 * 3600);
+  TEST_ASSERT_EQUAL_UINT32(0, on_seconds(LIGHT_STATS_24H));
+  TEST_ASSERT_EQUAL_UINT32(1200, on_seconds(LIGHT_STATS_7D));
+
+  run_minutes(60);
+  TEST_ASSERT_EQUAL_UINT32(1200, on_seconds(LIGHT_STATS_7D));
+}
+
+static void test_downtime_longer_than_the_ring() {
+  reboot_after(8 * 24 * 3600);
+  TEST_ASSERT_EQUAL_UINT32(0, on_seconds(LIGHT_STATS_24H));
+  TEST_ASSERT_EQUAL_UINT32(0, on_seconds(LIGHT_STATS_7D));
+  TEST_ASSERT_EQUAL_UINT32(11100, get_light_stats().lifetimeOnSeconds);
+  TEST_ASSERT_EQUAL_UINT32(5, get_light_stats().lifetimeSwitchCount);
+}
+
+int main() {
+  fake_clock_set_epoch(START_EPOCH);
+  setup_light_stats();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_empty);
+  RUN_TEST(test_on_time_and_occupancy);
+  RUN_TEST(test_on_time_spanning_buckets);
+  RUN_TEST(test_hours_leave_the_24h_window);
+  RUN_TEST(test_hours_leave_the_7d_window);
+  RUN_TEST(test_short_downtime_keeps_recent_hours);
+  RUN_TEST(test_downtime_rolls_the_buckets);
+  RUN_TEST(test_downtime_longer_than_the_ring);
+  return UNITY_END();
+}
@@ -0,0 +1,117 @@
+// Per-stage timing windows of the loop profiler (loop_profiler.cpp). Windows
+// follow each other, so the tests run in order on one timeline.
+//
+//   pio test -e native -f test_loop_profiler
+
+#include <string.h>
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "hal_fake.h"
+#include "loop_profiler.h"
+
+static void time_stage(ProfileStage stage, unsigned long us) {
+  uint32_t start = profile_start();
+  fake_clock_advance_us(us);
+  profile_end(stage, start);
+}
+
+// Ends the current window; stages close it on their next sample
+static void roll_window() {
+  fake_clock_advance_ms(PROFILER_REPORT_INTERVAL);
+  loop_profiler();
+}
+
+// Publishes the window that roll_window() ended
+static void report() {
+  fake_clock_advance_ms(250);
+  loop_profiler();
+}
+
+// Nothing writes concurrently here, so the read always succeeds; if it did
+// not, the poisoned copy would fail the checks
+static ProfileStats stats_of(ProfileStage stage) {
+  ProfileStats stats;
+  memset(&stats, 0xff, sizeof(stats));
+  get_profile_stats(stage, stats);
+  return stats;
+}
+
+static bool summary_contains(const char* text) {
+  const char* payload = fake_mqtt_last_payload(MQTT_TOPIC_DIAGNOSTICS_LOOP);
+  return payload != nullptr && strstr(payload, text) != nullptr;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_nothing_reported_before_the_first_window() {
+  time_stage(PROFILE_LIGHTS, 10);
+  TEST_ASSERT_EQUAL_UINT32(0, stats_of(PROFILE_LIGHTS).count);
+}
+
+static void test_window_summary() {
+  for (int i = 0; i < 98; i++) time_stage(PROFILE_LIGHTS, 10);
+  time_stage(PROFILE_LIGHTS, 1000);
+  time_stage(PROFILE_MOTION, 50);
+  roll_window();
+  time_stage(PROFILE_LIGHTS, 10);  // Closes the window
+  report();
+
+  ProfileStats stats = stats_of(PROFILE_LIGHTS);
+  TEST_ASSERT_EQUAL_UINT32(100, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(10, stats.minUs);
+  TEST_ASSERT_EQUAL_UINT32(19, stats.avgUs);    // 1990 us over 100 samples
+  TEST_ASSERT_EQUAL_UINT32(1000, stats.maxUs);
+  TEST_ASSERT_EQUAL_UINT32(15, stats.p99Us);    // Top of the [8, 16) bucket
+  TEST_ASSERT_TRUE(summary_contains("\"lights\":[10,19,1000,15]"));
+}
+
+// MOTION sampled in the window but not since, so its window never closed;
+// it must not stand in with another window's numbers
+static void test_unclosed_stage_is_empty() {
+  TEST_ASSERT_EQUAL_UINT32(0, stats_of(PROFILE_MOTION).count);
+  TEST_ASSERT_TRUE(summary_contains("\"motion\":null"));
+}
+
+static void test_stage_idle_for_a_window_is_empty() {
+  time_stage(PROFILE_DISPLAY, 2000);
+  roll_window();
+  time_stage(PROFILE_DISPLAY, 2000);  // Closes the window with the first sample
+  report();
+  TEST_ASSERT_EQUAL_UINT32(1, stats_of(PROFILE_DISPLAY).count);
+  TEST_ASSERT_TRUE(summary_contains("\"display\":[2000,2000,2000,2000]"));
+
+  // No display samples at all in the next window: the panel went to sleep
+  roll_window();
+  report();
+  TEST_ASSERT_EQUAL_UINT32(0, stats_of(PROFILE_DISPLAY).count);
+  TEST_ASSERT_TRUE(summary_contains("\"display\":null"));
+}
+
+// The worst case, every stage with 10-digit timings, still fits
+static void test_large_timings_are_published_whole() {
+  roll_window();
+  for (int s = 0; s < PROFILE_STAGE_COUNT; s++) time_stage((ProfileStage)s, 4000000000UL);
+  roll_window();
+  for (int s = 0; s < PROFILE_STAGE_COUNT; s++) time_stage((ProfileStage)s, 1);
+  report();
+  TEST_ASSERT_TRUE(summary_contains("\"mqtt\":[4000000000,4000000000,4000000000,"));
+  TEST_ASSERT_TRUE(summary_contains("\"heap_frag_pct\":"));
+}
+
+int main() {
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.setBufferSize(MQTT_BUFFER_SIZE);  // As setup() does
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+  setup_profiler();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_reported_before_the_first_window);
+  RUN_TEST(test_window_summary);
+  RUN_TEST(test_unclosed_stage_is_empty);
+  RUN_TEST(test_stage_idle_for_a_window_is_empty);
+  RUN_TEST(test_large_timings_are_published_whole);
+  return UNITY_END();
+}
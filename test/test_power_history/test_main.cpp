@@ -0,0 +1,184 @@
+// Multi-resolution power history (power_history.cpp): slot closing, the
+// cascade into coarser tiers, ring wraparound and the reader's seqlock.
+// The rings keep their contents between tests, so they run in order.
+//
+//   pio test -e native -f test_power_history
+
+#include <atomic>
+#include <string.h>
+#include <thread>
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "hal_fake.h"
+#include "power_history.h"
+
+// One reading with the same voltage, current and power on every channel
+static void record(float volts, float milliamps, float milliwatts) {
+  const float busVoltage[3] = {volts, volts, volts};
+  const float current[3] = {milliamps, milliamps, milliamps};
+  const float power[3] = {milliwatts, milliwatts, milliwatts};
+  history_record_sample(busVoltage, current, power);
+}
+
+// A constant reading every 250 ms, like the sensor task
+static void hold(float volts, unsigned long ms) {
+  for (unsigned long t = 0; t < ms; t += 250) {
+    record(volts, 100.0f, 1000.0f);
+    fake_clock_advance_ms(250);
+  }
+}
+
+// Fills exactly one 1 s slot with a constant reading. The first sample closes
+// the previous slot, or is repeated until one closes, so slots stay aligned.
+static void hold_slot(float volts) {
+  uint32_t sequence = history_sequence(HISTORY_1S);
+  for (;;) {
+    record(volts, 100.0f, 1000.0f);
+    fake_clock_advance_ms(250);
+    if (history_sequence(HISTORY_1S) != sequence) break;
+  }
+  for (int i = 0; i < 3; i++) {
+    record(volts, 100.0f, 1000.0f);
+    fake_clock_advance_ms(250);
+  }
+}
+
+static HistoryPoint newest(HistoryTier tier, HistoryQuantity quantity, int age = 0) {
+  HistoryPoint point = {NAN, NAN, NAN};
+  history_get(tier, 1, quantity, age, point);
+  return point;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_starts_empty() {
+  TEST_ASSERT_EQUAL_INT(0, history_count(HISTORY_1S));
+  HistoryPoint point;
+  TEST_ASSERT_FALSE(history_get(HISTORY_1S, 1, HISTORY_VOLTAGE, 0, point));
+}
+
+// A slot closes on the first sample past its second
+static void test_second_slot_min_mean_max() {
+  const float volts[4] = {12.0f, 12.2f, 12.4f, 12.6f};
+  for (float v : volts) {
+    record(v, 100.0f, 1000.0f);
+    fake_clock_advance_ms(250);
+  }
+  TEST_ASSERT_EQUAL_INT(0, history_count(HISTORY_1S));
+  record(12.0f, 100.0f, 1000.0f);
+  TEST_ASSERT_EQUAL_INT(1, history_count(HISTORY_1S));
+
+  HistoryPoint point = newest(HISTORY_1S, HISTORY_VOLTAGE);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 12.0f, point.min);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 12.3f, point.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 12.6f, point.max);
+}
+
+static void test_out_of_range_reads_fail() {
+  HistoryPoint point;
+  TEST_ASSERT_FALSE(history_get(HISTORY_1S, 0, HISTORY_VOLTAGE, 0, point));
+  TEST_ASSERT_FALSE(history_get(HISTORY_1S, 4, HISTORY_VOLTAGE, 0, point));
+  TEST_ASSERT_FALSE(history_get(HISTORY_1S, 1, HISTORY_VOLTAGE, 1, point));
+  TEST_ASSERT_FALSE(history_get(HISTORY_1S, 1, HISTORY_VOLTAGE, -1, point));
+}
+
+// Values are stored as int16: power in 10 mW steps up to 327.67 W
+static void test_packing_clamps_and_keeps_sign() {
+  fake_clock_advance_ms(250);
+  record(12.0f, -1500.0f, 400000.0f);
+  fake_clock_advance_ms(1000);
+  record(12.0f, 100.0f, 1000.0f);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, -1500.0f, newest(HISTORY_1S, HISTORY_CURRENT).min);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 327670.0f, newest(HISTORY_1S, HISTORY_POWER).max);
+}
+
+// Each minute slot is folded from the second slots below it
+static void test_minute_slot_from_second_slots() {
+  uint32_t sequence = history_sequence(HISTORY_1MIN);
+  hold(13.0f, 60000);
+  hold(13.0f, 1000);
+  TEST_ASSERT_EQUAL_UINT32(sequence + 1, history_sequence(HISTORY_1MIN));
+  TEST_ASSERT_EQUAL_INT(1, history_count(HISTORY_1MIN));
+  HistoryPoint point = newest(HISTORY_1MIN, HISTORY_VOLTAGE);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 12.0f, point.min);   // From the first slots
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 13.0f, point.max);
+  TEST_ASSERT_TRUE(point.mean > 12.9f && point.mean < 13.0f);
+}
+
+static void test_ring_wraps_at_capacity() {
+  for (int s = 0; s < HISTORY_1S_SLOTS + 10; s++) hold_slot(10.0f + s * 0.01f);
+  hold_slot(0.0f);  // Closes the last one
+  TEST_ASSERT_EQUAL_INT(HISTORY_1S_SLOTS, history_count(HISTORY_1S));
+  int newestSlot = HISTORY_1S_SLOTS + 9;
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 10.0f + newestSlot * 0.01f, newest(HISTORY_1S, HISTORY_VOLTAGE).mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 10.0f + (newestSlot - HISTORY_1S_SLOTS + 1) * 0.01f,
+                           newest(HISTORY_1S, HISTORY_VOLTAGE, HISTORY_1S_SLOTS - 1).mean);
+}
+
+// A gap in the samples (sensor task stalled) leaves no empty slots behind
+static void test_gap_closes_one_slot() {
+  uint32_t sequence = history_sequence(HISTORY_1S);
+  fake_clock_advance_ms(10000);
+  record(14.0f, 100.0f, 1000.0f);
+  TEST_ASSERT_EQUAL_UINT32(sequence + 1, history_sequence(HISTORY_1S));
+  fake_clock_advance_ms(1000);
+  record(14.0f, 100.0f, 1000.0f);
+  TEST_ASSERT_FLOAT_WITHIN(0.0005f, 14.0f, newest(HISTORY_1S, HISTORY_VOLTAGE).mean);
+}
+
+static void test_query_reply() {
+  handle_history_command("1 1m", 4);
+  const char* payload = fake_mqtt_last_payload(MQTT_TOPIC_HISTORY_STATE);
+  TEST_ASSERT_NOT_NULL(payload);
+  TEST_ASSERT_NOT_NULL(strstr(payload, "{\"ch\":1,\"tier\":\"1m\",\"period_s\":60,\"mv\":[[12000,"));
+  unsigned long published = fake_mqtt_publish_count();
+  handle_history_command("4 1m", 4);
+  handle_history_command("1 2m", 4);
+  TEST_ASSERT_EQUAL_UINT32(published, fake_mqtt_publish_count());
+}
+
+// Slots are written while another task reads them; a torn read would mix
+// two slots, each of which is one constant reading
+static void test_reader_never_sees_a_torn_slot() {
+  for (int s = 0; s <= HISTORY_1S_SLOTS; s++) hold_slot(1.0f);  // Flush the mixed slots above
+  std::atomic<bool> done{false};
+  std::atomic<long> torn{0};
+  std::atomic<long> reads{0};
+  std::thread reader([&] {
+    while (!done.load()) {
+      HistoryPoint point;
+      if (history_get(HISTORY_1S, 2, HISTORY_VOLTAGE, HISTORY_1S_SLOTS - 1, point)) {
+        if (point.min != point.max || point.mean != point.min) torn++;
+        reads++;
+      }
+    }
+  });
+  for (int s = 0; s < 500000; s++) {
+    record(1.0f + (s % 20), 100.0f, 1000.0f);
+    fake_clock_advance_ms(1000);
+  }
+  done = true;
+  reader.join();
+  TEST_ASSERT_EQUAL_INT(0, torn.load());
+  TEST_ASSERT_TRUE(reads.load() > 0);
+}
+
+int main() {
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_starts_empty);
+  RUN_TEST(test_second_slot_min_mean_max);
+  RUN_TEST(test_out_of_range_reads_fail);
+  RUN_TEST(test_packing_clamps_and_keeps_sign);
+  RUN_TEST(test_minute_slot_from_second_slots);
+  RUN_TEST(test_ring_wraps_at_capacity);
+  RUN_TEST(test_gap_closes_one_slot);
+  RUN_TEST(test_query_reply);
+  RUN_TEST(test_reader_never_sees_a_torn_slot);
+  return UNITY_END();
+}
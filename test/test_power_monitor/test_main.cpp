@@ -0,0 +1,85 @@
+// Report-by-exception publishing of the power channels (power_monitor.cpp):
+// a channel is only published when a reading leaves its POWER_DEADBANDS
+// entry, or when its POWER_PUBLISH_HEARTBEAT is due.
+//
+//   pio test -e native -f test_power_monitor
+
+#include <unity.h>
+#include "config.h"
+#include "connections.h"
+#include "hal_fake.h"
+#include "power_monitor.h"
+
+// Slightly longer than the sensor task's 250 ms read interval
+static const unsigned long SAMPLE_STEP_MS = 251;
+
+// Takes one sample and runs the publisher; returns the number of publishes
+static unsigned long sample(float solarVolts, float solarAmps) {
+  fake_ina226_set(INA226_CH1_ADDRESS, solarVolts, solarAmps);
+  fake_clock_advance_ms(SAMPLE_STEP_MS);
+  fake_mqtt_reset_counters();
+  loop_power_monitor();
+  loop_power_publisher();
+  return fake_mqtt_publish_count();
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Every fitted channel goes out once; CH2 is not fitted
+static void test_first_sample_publishes_fitted_channels() {
+  TEST_ASSERT_EQUAL_UINT32(2, sample(18.0f, 1.0f));
+  TEST_ASSERT_EQUAL_STRING("{\"bus_voltage\":18.000,\"current\":1000.0,\"power\":18000.0}",
+                           fake_mqtt_last_payload(MQTT_TOPIC_POWER_CH1_STATE));
+  TEST_ASSERT_NULL(fake_mqtt_last_payload(MQTT_TOPIC_POWER_CH2_STATE));
+}
+
+// Solar band at 18 V / 1 A: 0.09 V, 20 mA and 360 mW
+static void test_change_inside_deadband_is_held() {
+  TEST_ASSERT_EQUAL_UINT32(0, sample(18.0f, 1.0f));
+  TEST_ASSERT_EQUAL_UINT32(0, sample(18.05f, 1.01f));
+  TEST_ASSERT_EQUAL_UINT32(0, sample(17.95f, 0.99f));
+}
+
+static void test_voltage_step_publishes() {
+  TEST_ASSERT_EQUAL_UINT32(1, sample(18.2f, 1.0f));
+  TEST_ASSERT_EQUAL_STRING("{\"bus_voltage\":18.200,\"current\":1000.0,\"power\":18200.0}",
+                           fake_mqtt_last_payload(MQTT_TOPIC_POWER_CH1_STATE));
+}
+
+static void test_current_step_publishes() {
+  TEST_ASSERT_EQUAL_UINT32(1, sample(18.2f, 1.05f));
+}
+
+// The band is measured from the last published value, so a slow creep is
+// published once it adds up instead of never
+static void test_slow_drift_is_published_once_it_adds_up() {
+  unsigned long published = 0;
+  for (int i = 1; i <= 10; i++) published += sample(18.2f + 0.02f * i, 1.05f);
+  TEST_ASSERT_EQUAL_UINT32(2, published);
+}
+
+static void test_heartbeat_republishes_unchanged_channels() {
+  unsigned long published = 0;
+  unsigned long samples = POWER_PUBLISH_HEARTBEAT / SAMPLE_STEP_MS + 1;
+  for (unsigned long i = 0; i < samples; i++) published += sample(18.4f, 1.05f);
+  TEST_ASSERT_EQUAL_UINT32(2, published);  // CH1 and CH3, once each
+}
+
+int main() {
+  fake_ina226_set(INA226_CH3_ADDRESS, 12.0f, 0.5f);
+  fake_wifi_set_connected(true);
+  fake_mqtt_set_broker_online(true);
+  client.setBufferSize(MQTT_BUFFER_SIZE);  // As setup() does
+  client.connect("test", nullptr, nullptr, MQTT_TOPIC_AVAILABILITY, 1, true, MQTT_PAYLOAD_OFFLINE);
+  setup_power_monitor();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_first_sample_publishes_fitted_channels);
+  RUN_TEST(test_change_inside_deadband_is_held);
+  RUN_TEST(test_voltage_step_publishes);
+  RUN_TEST(test_current_step_publishes);
+  RUN_TEST(test_slow_drift_is_published_once_it_adds_up);
+  RUN_TEST(test_heartbeat_republishes_unchanged_channels);
+  return UNITY_END();
+}
@@ -0,0 +1,105 @@
+// NVS-backed settings (settings.cpp): range checks, coalescing a burst of
+// edits into one flash write, and reloading what was stored. The in-memory
+// NVS keeps its contents between tests, so they run in order.
+//
+//   pio test -e native -f test_settings
+
+#include <Preferences.h>
+#include <unity.h>
+#include "config.h"
+#include "hal_fake.h"
+#include "settings.h"
+
+// Runs the sensor task's flush every 250 ms for the given time
+static void run_settings(unsigned long ms) {
+  for (unsigned long t = 0; t < ms; t += 250) {
+    loop_settings();
+    fake_clock_advance_ms(250);
+  }
+  loop_settings();
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_defaults_without_writes() {
+  setup_settings();
+  TEST_ASSERT_EQUAL_UINT32(10000, get_setting(SETTING_MOTION_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(300000, get_setting(SETTING_MANUAL_TIMER));
+  run_settings(SETTINGS_WRITE_DELAY * 2);
+  TEST_ASSERT_EQUAL_UINT32(0, fake_nvs_write_count());
+}
+
+static void test_out_of_range_rejected() {
+  TEST_ASSERT_FALSE(set_setting(SETTING_MOTION_TIMER, 9999));
+  TEST_ASSERT_FALSE(set_setting(SETTING_MANUAL_TIMER, 3600001));
+  TEST_ASSERT_EQUAL_UINT32(10000, get_setting(SETTING_MOTION_TIMER));
+  run_settings(SETTINGS_WRITE_DELAY * 2);
+  TEST_ASSERT_EQUAL_UINT32(0, fake_nvs_write_count());
+}
+
+// Encoder-style edits every 200 ms keep pushing the write back; only the
+// final value is written, once, after the quiet period.
+static void test_burst_costs_one_write() {
+  unsigned long writes = fake_nvs_write_count();
+  for (uint32_t seconds = 20; seconds <= 60; seconds++) {
+    TEST_ASSERT_TRUE(set_setting(SETTING_MOTION_TIMER, seconds * 1000));
+    loop_settings();
+    fake_clock_advance_ms(200);
+  }
+  TEST_ASSERT_EQUAL_UINT32(60000, get_setting(SETTING_MOTION_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(writes, fake_nvs_write_count());
+
+  run_settings(SETTINGS_WRITE_DELAY - 500);
+  TEST_ASSERT_EQUAL_UINT32(writes, fake_nvs_write_count());
+  run_settings(1000);
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, fake_nvs_write_count());
+  run_settings(SETTINGS_WRITE_DELAY * 2);
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, fake_nvs_write_count());
+}
+
+static void test_edit_back_to_stored_value_is_free() {
+  unsigned long writes = fake_nvs_write_count();
+  set_setting(SETTING_MOTION_TIMER, 90000);
+  set_setting(SETTING_MOTION_TIMER, 60000);
+  run_settings(SETTINGS_WRITE_DELAY * 2);
+  TEST_ASSERT_EQUAL_UINT32(writes, fake_nvs_write_count());
+}
+
+static void test_each_changed_setting_written_once() {
+  unsigned long writes = fake_nvs_write_count();
+  set_setting(SETTING_MOTION_TIMER, 45000);
+  set_setting(SETTING_MANUAL_TIMER, 600000);
+  set_setting(SETTING_MANUAL_TIMER, 900000);
+  run_settings(SETTINGS_WRITE_DELAY * 2);
+  TEST_ASSERT_EQUAL_UINT32(writes + 2, fake_nvs_write_count());
+}
+
+static void test_reload_after_reboot() {
+  setup_settings();
+  TEST_ASSERT_EQUAL_UINT32(45000, get_setting(SETTING_MOTION_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(900000, get_setting(SETTING_MANUAL_TIMER));
+}
+
+static void test_corrupt_stored_value_falls_back_to_default() {
+  Preferences prefs;
+  prefs.begin("settings", false);
+  prefs.putUInt("motion_ms", 5);
+  prefs.end();
+
+  setup_settings();
+  TEST_ASSERT_EQUAL_UINT32(10000, get_setting(SETTING_MOTION_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(900000, get_setting(SETTING_MANUAL_TIMER));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults_without_writes);
+  RUN_TEST(test_out_of_range_rejected);
+  RUN_TEST(test_burst_costs_one_write);
+  RUN_TEST(test_edit_back_to_stored_value_is_free);
+  RUN_TEST(test_each_changed_setting_written_once);
+  RUN_TEST(test_reload_after_reboot);
+  RUN_TEST(test_corrupt_stored_value_falls_back_to_default);
+  return UNITY_END();
+}
@@ -0,0 +1,98 @@
+// Lock-free single-producer single-consumer queue (spsc_queue.h): full and
+// empty, index wraparound, and ordering between two threads.
+//
+//   pio test -e native -f test_spsc_queue
+
+#include <thread>
+#include <unity.h>
+#include "spsc_queue.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_empty_queue_pops_nothing() {
+  SpscQueue<int, 4> queue;
+  int item = 42;
+  TEST_ASSERT_FALSE(queue.pop(item));
+  TEST_ASSERT_EQUAL_INT(42, item);
+}
+
+static void test_every_slot_is_usable() {
+  SpscQueue<int, 4> queue;
+  for (int i = 0; i < 4; i++) TEST_ASSERT_TRUE(queue.push(i));
+  TEST_ASSERT_FALSE(queue.push(4));
+
+  int item;
+  for (int i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_INT(i, item);
+  }
+  TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+static void test_full_queue_accepts_again_after_pop() {
+  SpscQueue<int, 2> queue;
+  queue.push(1);
+  queue.push(2);
+  TEST_ASSERT_FALSE(queue.push(3));
+
+  int item;
+  queue.pop(item);
+  TEST_ASSERT_TRUE(queue.push(3));
+  queue.pop(item);
+  TEST_ASSERT_EQUAL_INT(2, item);
+  queue.pop(item);
+  TEST_ASSERT_EQUAL_INT(3, item);
+}
+
+static void test_indices_wrap() {
+  SpscQueue<int, 4> queue;
+  int item;
+  for (int i = 0; i < 1000; i++) {
+    TEST_ASSERT_TRUE(queue.push(i));
+    TEST_ASSERT_TRUE(queue.push(-i));
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_INT(i, item);
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL_INT(-i, item);
+  }
+  TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+// The producer retries on a full queue and the consumer on an empty one,
+// yielding like the tasks do on a single core; every item must arrive
+// exactly once and in order.
+static void test_two_threads_keep_order() {
+  static SpscQueue<unsigned, 8> queue;
+  const unsigned ITEMS = 200000;
+
+  std::thread producer([&] {
+    for (unsigned i = 0; i < ITEMS; i++) {
+      while (!queue.push(i)) std::this_thread::yield();
+    }
+  });
+
+  unsigned expected = 0, outOfOrder = 0, item;
+  while (expected < ITEMS) {
+    if (!queue.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (item != expected) outOfOrder++;
+    expected++;
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL_UINT(0, outOfOrder);
+  TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_queue_pops_nothing);
+  RUN_TEST(test_every_slot_is_usable);
+  RUN_TEST(test_full_queue_accepts_again_after_pop);
+  RUN_TEST(test_indices_wrap);
+  RUN_TEST(test_two_threads_keep_order);
+  return UNITY_END();
+}
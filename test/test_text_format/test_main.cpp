@@ -0,0 +1,88 @@
+// TextBuffer and the single-field shortcuts (text_format.h).
+//
+//   pio test -e native -f test_text_format
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "text_format.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_integers() {
+  char text[32];
+  TextBuffer out(text, sizeof(text));
+  out.append_unsigned(0).append(' ').append_unsigned(4294967295UL).append(' ');
+  out.append_signed(-42).append(' ').append_signed(INT32_MIN);
+  TEST_ASSERT_EQUAL_STRING("0 4294967295 -42 -2147483648", text);
+  TEST_ASSERT_FALSE(out.overflowed());
+}
+
+static void test_fixed_rounds_once() {
+  char text[16];
+  format_fixed(text, sizeof(text), 3.14159f, 3);
+  TEST_ASSERT_EQUAL_STRING("3.142", text);
+  format_fixed(text, sizeof(text), 12.5f, 0);
+  TEST_ASSERT_EQUAL_STRING("13", text);
+  format_fixed(text, sizeof(text), 0.999f, 2);
+  TEST_ASSERT_EQUAL_STRING("1.00", text);
+  format_fixed(text, sizeof(text), -1.25f, 1);
+  TEST_ASSERT_EQUAL_STRING("-1.3", text);
+}
+
+static void test_fixed_has_no_negative_zero() {
+  char text[16];
+  format_fixed(text, sizeof(text), -0.04f, 1);
+  TEST_ASSERT_EQUAL_STRING("0.0", text);
+}
+
+static void test_fixed_pads_the_fraction() {
+  char text[16];
+  format_fixed(text, sizeof(text), 7.005f, 3);
+  TEST_ASSERT_EQUAL_STRING("7.005", text);
+  format_fixed(text, sizeof(text), 2.0f, 4);
+  TEST_ASSERT_EQUAL_STRING("2.0000", text);
+}
+
+// These go straight into JSON payloads, which have no NaN or infinity
+static void test_non_finite_is_json_null() {
+  char text[16];
+  format_fixed(text, sizeof(text), NAN, 2);
+  TEST_ASSERT_EQUAL_STRING("null", text);
+  format_fixed(text, sizeof(text), INFINITY, 2);
+  TEST_ASSERT_EQUAL_STRING("null", text);
+  format_fixed(text, sizeof(text), -INFINITY, 2);
+  TEST_ASSERT_EQUAL_STRING("null", text);
+}
+
+static void test_duration() {
+  char text[DURATION_TEXT_SIZE];
+  format_duration(text, 3723000);
+  TEST_ASSERT_EQUAL_STRING("01:02:03", text);
+  format_duration(text, 999);
+  TEST_ASSERT_EQUAL_STRING("00:00:00", text);
+  format_duration(text, 360000000UL);
+  TEST_ASSERT_EQUAL_STRING("100:00:00", text);
+}
+
+static void test_overflow_truncates_and_terminates() {
+  char text[6];
+  TextBuffer out(text, sizeof(text));
+  out.append("abc").append_unsigned(12345);
+  TEST_ASSERT_TRUE(out.overflowed());
+  TEST_ASSERT_EQUAL_STRING("abc12", text);
+  TEST_ASSERT_EQUAL_UINT32(5, out.length());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_integers);
+  RUN_TEST(test_fixed_rounds_once);
+  RUN_TEST(test_fixed_has_no_negative_zero);
+  RUN_TEST(test_fixed_pads_the_fraction);
+  RUN_TEST(test_non_finite_is_json_null);
+  RUN_TEST(test_duration);
+  RUN_TEST(test_overflow_truncates_and_terminates);
+  return UNITY_END();
+}
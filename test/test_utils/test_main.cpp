@@ -0,0 +1,85 @@
+// MQTT payload parsing and topic hashing (utils.h).
+//
+//   pio test -e native -f test_utils
+
+#include <string.h>
+#include <unity.h>
+#include "utils.h"
+
+void setUp() {}
+void tearDown() {}
+
+static bool parse(const char* text, unsigned long& value) {
+  return parse_unsigned(text, strlen(text), value);
+}
+
+static void test_plain_numbers() {
+  unsigned long value = 0;
+  TEST_ASSERT_TRUE(parse("300", value));
+  TEST_ASSERT_EQUAL_UINT32(300, value);
+  TEST_ASSERT_TRUE(parse("0", value));
+  TEST_ASSERT_EQUAL_UINT32(0, value);
+}
+
+static void test_spaces_and_fraction() {
+  unsigned long value = 0;
+  TEST_ASSERT_TRUE(parse("  42 ", value));
+  TEST_ASSERT_EQUAL_UINT32(42, value);
+  TEST_ASSERT_TRUE(parse("300.0", value));
+  TEST_ASSERT_EQUAL_UINT32(300, value);
+  TEST_ASSERT_TRUE(parse("12.9", value));  // Truncated, not rounded
+  TEST_ASSERT_EQUAL_UINT32(12, value);
+  TEST_ASSERT_TRUE(parse("7.", value));
+  TEST_ASSERT_EQUAL_UINT32(7, value);
+}
+
+static void test_rejects_malformed() {
+  unsigned long value = 1234;
+  TEST_ASSERT_FALSE(parse("", value));
+  TEST_ASSERT_FALSE(parse("   ", value));
+  TEST_ASSERT_FALSE(parse("abc", value));
+  TEST_ASSERT_FALSE(parse("12a", value));
+  TEST_ASSERT_FALSE(parse("-5", value));
+  TEST_ASSERT_FALSE(parse(".5", value));
+  TEST_ASSERT_FALSE(parse("1 2", value));
+  TEST_ASSERT_FALSE(parse("99999999999999999999999", value));
+  TEST_ASSERT_EQUAL_UINT32(1234, value);  // Untouched on failure
+}
+
+// Payloads are not NUL-terminated; nothing past `length` may be read
+static void test_stops_at_length() {
+  unsigned long value = 0;
+  TEST_ASSERT_TRUE(parse_unsigned("123456", 3, value));
+  TEST_ASSERT_EQUAL_UINT32(123, value);
+  TEST_ASSERT_FALSE(parse_unsigned("123", 0, value));
+}
+
+static void test_payload_equals() {
+  TEST_ASSERT_TRUE(payload_equals("ON", 2, "ON"));
+  TEST_ASSERT_FALSE(payload_equals("ONX", 3, "ON"));
+  TEST_ASSERT_FALSE(payload_equals("O", 1, "ON"));
+}
+
+// Published 32-bit FNV-1a test vectors
+static void test_hash_known_values() {
+  TEST_ASSERT_EQUAL_UINT32(0x811c9dc5UL, hash_topic("", 0));
+  TEST_ASSERT_EQUAL_UINT32(0xe40c292cUL, hash_topic("a", 1));
+  TEST_ASSERT_EQUAL_UINT32(0xbf9cf968UL, hash_topic("foobar", 6));
+}
+
+static void test_hash_stops_at_length() {
+  TEST_ASSERT_EQUAL_UINT32(hash_topic("foo", 3), hash_topic("foobar", 3));
+  TEST_ASSERT_TRUE(hash_topic("foo", 3) != hash_topic("foobar", 6));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_numbers);
+  RUN_TEST(test_spaces_and_fraction);
+  RUN_TEST(test_rejects_malformed);
+  RUN_TEST(test_stops_at_length);
+  RUN_TEST(test_payload_equals);
+  RUN_TEST(test_hash_known_values);
+  RUN_TEST(test_hash_stops_at_length);
+  return UNITY_END();
+}